@@ -0,0 +1,879 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ibus.h"
+#include "ibus_ring.h"
+#include "ibus_snapshot.h"
+#include "ibus_queue.h"
+#include "ibus_sensor.h"
+#include "ibus_map.h"
+#include "ibus_output.h"
+#include "ibus_stats.h"
+#include "ibus_stream.h"
+#include "ibus_sim.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLES 1
+#endif
+
+/*
+  Host benchmarks for the iBUS stack. Run without arguments for every suite
+  or pass suite names to pick some of them.
+
+  The parse, flips, drops, garbage and truncated suites feed the parser from
+  the simulated UART in ibus_sim.h. Its traffic is set with --seed=, --baud=,
+  --frame-us= and --frames=, the parse suite also takes --flip-ppm=,
+  --drop-ppm=, --noise-ppm= and --truncate-ppm= to inject errors of its own.
+  --max-latency-ns= and --min-mbps= fail those suites when the p99 decode
+  latency or the throughput is out of budget, to catch a slower hot path
+  before it is flashed. The bench target passes both, ctest runs the suites
+  without them so only wrong results fail there.
+ */
+
+#define BENCH_FRAMES 200000
+// at most one frame in this many that went out intact may be lost, a false
+// header passing the checksum by chance costs one now and then
+#define BENCH_MAX_LOSS 10000
+#define BENCH_LINE_FRAMES 200
+#define BENCH_RING_SIZE 256
+// one byte at 115200 baud, 8N1
+#define BENCH_BYTE_NS 86806
+#define BENCH_POLL_NS 2000000
+#define BENCH_SNAPSHOT_FRAMES 2000000
+#define BENCH_SNAPSHOT_READERS 2
+#define BENCH_QUEUE_FRAMES 2000000
+#define BENCH_QUEUE_PACED_FRAMES 50000
+#define BENCH_QUEUE_PERIOD_NS 20000
+#define BENCH_SENSOR_ROUNDS 100000
+#define BENCH_MAP_FRAMES 1000000
+#define BENCH_OUTPUT_FRAMES 200000
+#define BENCH_OUTPUTS 4
+#define BENCH_FRAME_US 7000
+#define BENCH_FAILSAFE_US 100000
+#define BENCH_CHECK_US 10000
+#define BENCH_STATS_FRAMES 1000000
+#define BENCH_STREAM_RECORDS 200000
+
+static uint32_t seed = 0x1B05;
+
+// xorshift, good enough for generating traffic and repeatable between runs
+static uint32_t bench_rand() {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+static uint64_t bench_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static uint64_t bench_cycles() {
+#ifdef HAVE_CYCLES
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// fill a buffer with back to back servo frames carrying random sticks
+static size_t bench_stream(uint8_t *out, size_t frames) {
+    size_t n = 0;
+    uint16_t channel[IBUS_FRAME_CHANNELS];
+    for (size_t f = 0; f < frames; f++) {
+        for (uint8_t i = 0; i < IBUS_FRAME_CHANNELS; i++) {
+            channel[i] = 1000 + bench_rand() % 1001;
+        }
+        n += ibus_encode_channels(out + n, channel, IBUS_FRAME_CHANNELS);
+    }
+    return n;
+}
+
+// push a byte stream through a fresh parser, returns the valid frame count
+static size_t bench_parse(const uint8_t *data, size_t n) {
+    ibus_parser_t parser;
+    uint16_t channel[IBUS_CHANNELS];
+    size_t frames = 0;
+    ibus_parser_init(&parser);
+    for (size_t i = 0; i < n; i++) {
+        if (ibus_parser_feed(&parser, data[i])) {
+            ibus_decode_channels(parser.buffer, channel);
+            frames++;
+        }
+    }
+    return frames;
+}
+
+// traffic shared by the simulated link suites, changed from the command line
+static ibus_sim_config_t sim_config = IBUS_SIM_DEFAULT;
+static size_t sim_frames = BENCH_FRAMES;
+static uint64_t sim_max_latency_ns;
+static uint32_t sim_min_mbps;
+
+static int bench_compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// run simulated traffic through the parser three times: once straight from
+// the simulated UART to check every decoded frame, once from memory for
+// throughput and once timing each byte for per frame latency. The ring gets
+// the same bytes and has to hand out the same frames and errors as the parser.
+static int bench_sim(const char *name, const ibus_sim_config_t *config) {
+    size_t size = sim_frames * IBUS_MAX_LENGTH * 2;
+    uint8_t *data = malloc(size);
+    uint64_t *latency = malloc(sim_frames * sizeof(uint64_t));
+    uint16_t channel[IBUS_CHANNELS];
+    ibus_parser_t parser;
+    ibus_sim_t sim;
+    uint64_t line_ns = 0;
+    size_t n = 0, decoded = 0, wrong = 0, recovered = 0;
+    ibus_sim_init(&sim, config);
+    ibus_parser_init(&parser);
+    while (sim.frames <= sim_frames && n < size) {
+        data[n] = ibus_sim_next(&sim, &line_ns);
+        if (ibus_parser_feed(&parser, data[n++])) {
+            // the simulator only moves on to the next frame on the next byte
+            ibus_decode_channels(parser.buffer, channel);
+            decoded++;
+            if (memcmp(channel, ibus_sim_channels(&sim), sizeof(channel)) != 0) wrong++;
+            else if (!sim.damaged) recovered++;
+        }
+    }
+    bool injected = sim.flips || sim.drops || sim.noise || sim.truncated;
+
+    // the ring is filled a few dozen bytes at a time like the DMA does it
+    // between two polls, each frame it finds has to be the parser's next one
+    static uint8_t ring_data[BENCH_RING_SIZE];
+    ibus_ring_t ring;
+    const uint8_t *out;
+    size_t ring_frames = 0, ring_wrong = 0, fed = 0;
+    uint32_t written = 0;
+    ibus_ring_init(&ring, ring_data, BENCH_RING_SIZE);
+    ibus_parser_init(&parser);
+    while (written < n) {
+        for (uint32_t chunk = 1 + bench_rand() % 64; chunk && written < n; chunk--) {
+            ring_data[written % BENCH_RING_SIZE] = data[written];
+            written++;
+        }
+        while (ibus_ring_next(&ring, written, &out)) {
+            ring_frames++;
+            while (fed < n && !ibus_parser_feed(&parser, data[fed++]));
+            if (memcmp(out, parser.buffer, out[0]) != 0) ring_wrong++;
+        }
+    }
+    while (fed < n) ibus_parser_feed(&parser, data[fed++]);
+    ibus_errors_t parser_errors = parser.errors;
+
+    uint64_t t0 = bench_now_ns();
+    uint64_t c0 = bench_cycles();
+    size_t frames = bench_parse(data, n);
+    uint64_t c1 = bench_cycles();
+    uint64_t t1 = bench_now_ns();
+
+    // latency from the last byte of a frame arriving to its channels decoded
+    size_t samples = 0;
+    ibus_parser_init(&parser);
+    for (size_t i = 0; i < n && samples < sim_frames; i++) {
+        uint64_t start = bench_now_ns();
+        if (ibus_parser_feed(&parser, data[i])) {
+            ibus_decode_channels(parser.buffer, channel);
+            latency[samples++] = bench_now_ns() - start;
+        }
+    }
+    qsort(latency, samples, sizeof(uint64_t), bench_compare_u64);
+    uint64_t p50 = samples ? latency[samples / 2] : 0;
+    uint64_t p99 = samples ? latency[samples * 99 / 100] : 0;
+    uint64_t worst = samples ? latency[samples - 1] : 0;
+
+    // frames decoded with channels that were never sent got past the checksum
+    double mbps = (double)n * 1000 / (t1 - t0);
+    printf("%s: %zu/%u intact frames recovered, %zu good of %zu sent, %zu undetected errors, injected %u flips %u drops %u noise %u truncated\n",
+        name, recovered, sim.intact, decoded - wrong, sim_frames, wrong,
+        sim.flips, sim.drops, sim.noise, sim.truncated);
+    printf("%s: %.1f MB/s, %.2f ns/byte, %.2f cycles/byte, %.0f frames/s, %.0fx line rate\n",
+        name, mbps,
+        (double)(t1 - t0) / n, (double)(c1 - c0) / n,
+        (double)frames * 1000000000 / (t1 - t0), (double)line_ns / (t1 - t0));
+    printf("%s: latency %lu ns median, %lu ns p99, %lu ns worst\n",
+        name, (unsigned long)p50, (unsigned long)p99, (unsigned long)worst);
+    printf("%s: ring %zu frames, %zu unlike the parser, %u checksum errors, %u resyncs, %u overruns\n",
+        name, ring_frames, ring_wrong, ring.errors.chksum_errors, ring.errors.resyncs,
+        ring.errors.overruns);
+    free(latency);
+    free(data);
+    int failed = frames != decoded;
+    // a clean link has to deliver every frame exactly, on a noisy one the
+    // frames around an error may go but the intact ones have to come back
+    if (!injected) failed |= decoded != sim.intact || wrong;
+    if (ring_frames != decoded || ring_wrong || ring.errors.overruns ||
+        ring.errors.chksum_errors != parser_errors.chksum_errors ||
+        ring.errors.resyncs != parser_errors.resyncs) {
+        printf("%s: ring and parser disagree\n", name);
+        failed = 1;
+    }
+    if ((sim.intact - recovered) * BENCH_MAX_LOSS > sim.intact) {
+        printf("%s: lost more than one intact frame in %d\n", name, BENCH_MAX_LOSS);
+        failed = 1;
+    }
+    if (sim_max_latency_ns && p99 > sim_max_latency_ns) {
+        printf("%s: p99 latency over the %lu ns budget\n", name, (unsigned long)sim_max_latency_ns);
+        failed = 1;
+    }
+    if (mbps < sim_min_mbps) {
+        printf("%s: throughput under the %u MB/s floor\n", name, sim_min_mbps);
+        failed = 1;
+    }
+    return failed;
+}
+
+static int suite_parse() {
+    return bench_sim("parse", &sim_config);
+}
+
+static int suite_flips() {
+    ibus_sim_config_t config = sim_config;
+    config.flip_ppm = 1000;
+    return bench_sim("flips", &config);
+}
+
+static int suite_drops() {
+    ibus_sim_config_t config = sim_config;
+    config.drop_ppm = 1000;
+    return bench_sim("drops", &config);
+}
+
+static int suite_garbage() {
+    ibus_sim_config_t config = sim_config;
+    config.noise_ppm = 20000;
+    return bench_sim("garbage", &config);
+}
+
+static int suite_truncated() {
+    ibus_sim_config_t config = sim_config;
+    config.truncate_ppm = 250000;
+    return bench_sim("truncated", &config);
+}
+
+static void bench_sleep_ns(uint64_t ns) {
+    struct timespec ts = { ns / 1000000000u, ns % 1000000000u };
+    nanosleep(&ts, NULL);
+}
+
+static int suite_ring() {
+    // producer and consumer interleaved on one thread, the byte count starts
+    // at a random offset so frames wrap around the end of the ring, and
+    // close enough to 2^32 that the count itself wraps as well
+    static uint8_t ring_data[BENCH_RING_SIZE];
+    uint8_t frame[IBUS_MAX_LENGTH];
+    ibus_ring_t ring;
+    const uint8_t *out;
+    size_t frames = 0;
+    size_t wrapped = 0;
+    uint64_t busy = 0;
+    uint32_t written = 0u - 1 - bench_rand() % (BENCH_FRAMES * IBUS_MAX_LENGTH);
+    ibus_ring_init(&ring, ring_data, BENCH_RING_SIZE);
+    ring.tail = written;
+    for (size_t f = 0; f < BENCH_FRAMES; f++) {
+        bench_stream(frame, 1);
+        for (uint8_t i = 0; i < IBUS_MAX_LENGTH; i++) {
+            ring_data[written++ % BENCH_RING_SIZE] = frame[i];
+        }
+        uint64_t t0 = bench_now_ns();
+        while (ibus_ring_next(&ring, written, &out)) {
+            frames++;
+            wrapped += out == ring.scratch;
+        }
+        busy += bench_now_ns() - t0;
+    }
+    printf("ring: %zu/%d frames, %zu linearized, %.1f ns/frame\n",
+        frames, BENCH_FRAMES, wrapped, (double)busy / BENCH_FRAMES);
+    return frames == BENCH_FRAMES && !ring.errors.overruns ? 0 : 1;
+}
+
+static uint8_t line_ring[BENCH_RING_SIZE];
+static atomic_uint line_written;
+
+// stand-in for the DMA channel, writes one byte per bit time
+static void *line_producer(void *arg) {
+    uint8_t frame[IBUS_MAX_LENGTH];
+    uint32_t written = 0;
+    uint64_t next = bench_now_ns();
+    (void)arg;
+    for (size_t f = 0; f < BENCH_LINE_FRAMES; f++) {
+        bench_stream(frame, 1);
+        for (uint8_t i = 0; i < IBUS_MAX_LENGTH; i++) {
+            next += BENCH_BYTE_NS;
+            while (bench_now_ns() < next);
+            line_ring[written++ % BENCH_RING_SIZE] = frame[i];
+            atomic_store_explicit(&line_written, written, memory_order_release);
+        }
+    }
+    return NULL;
+}
+
+static int suite_ring_linerate() {
+    // consumer polls like the firmware timer does while the producer runs
+    // in real time at 115200 baud
+    pthread_t producer;
+    ibus_ring_t ring;
+    const uint8_t *out;
+    size_t frames = 0;
+    size_t polls = 0;
+    atomic_store(&line_written, 0);
+    ibus_ring_init(&ring, line_ring, BENCH_RING_SIZE);
+    pthread_create(&producer, NULL, line_producer, NULL);
+    uint64_t end = bench_now_ns() + (uint64_t)BENCH_LINE_FRAMES * IBUS_MAX_LENGTH * BENCH_BYTE_NS + 2 * BENCH_POLL_NS;
+    while (bench_now_ns() < end) {
+        bench_sleep_ns(BENCH_POLL_NS);
+        uint32_t written = atomic_load_explicit(&line_written, memory_order_acquire);
+        while (ibus_ring_next(&ring, written, &out)) frames++;
+        polls++;
+    }
+    pthread_join(producer, NULL);
+    uint32_t written = atomic_load_explicit(&line_written, memory_order_acquire);
+    while (ibus_ring_next(&ring, written, &out)) frames++;
+    printf("ring_linerate: %zu/%d frames over %zu polls, %u overruns\n",
+        frames, BENCH_LINE_FRAMES, polls, ring.errors.overruns);
+    return frames == BENCH_LINE_FRAMES && !ring.errors.overruns ? 0 : 1;
+}
+
+static ibus_snapshot_t snapshot;
+static atomic_bool snapshot_done;
+
+// every channel of frame n carries a value derived from n, so a snapshot
+// mixing two frames is easy to spot
+static void snapshot_pattern(uint16_t *channel, uint32_t n) {
+    for (uint8_t i = 0; i < IBUS_CHANNELS; i++) {
+        channel[i] = n * 7 + i;
+    }
+}
+
+static void *snapshot_writer(void *arg) {
+    uint16_t channel[IBUS_CHANNELS];
+    (void)arg;
+    for (uint32_t n = 1; n <= BENCH_SNAPSHOT_FRAMES; n++) {
+        snapshot_pattern(channel, n);
+        ibus_snapshot_publish(&snapshot, channel, n);
+    }
+    atomic_store(&snapshot_done, true);
+    return NULL;
+}
+
+typedef struct {
+    size_t reads;
+    size_t torn;
+    size_t backwards;
+    uint64_t ns;
+} snapshot_reader_t;
+
+static void *snapshot_reader(void *arg) {
+    snapshot_reader_t *r = arg;
+    ibus_frame_snapshot_t frame;
+    uint16_t expect[IBUS_CHANNELS];
+    uint32_t last = 0;
+    uint64_t t0 = bench_now_ns();
+    while (!atomic_load(&snapshot_done)) {
+        if (!ibus_snapshot_read(&snapshot, &frame)) continue;
+        r->reads++;
+        snapshot_pattern(expect, frame.frame);
+        if (frame.timestamp != frame.frame || memcmp(expect, frame.channel, sizeof(expect)) != 0) r->torn++;
+        if (frame.frame < last) r->backwards++;
+        last = frame.frame;
+    }
+    r->ns = bench_now_ns() - t0;
+    return NULL;
+}
+
+static int suite_snapshot() {
+    ibus_frame_snapshot_t frame;
+    uint16_t channel[IBUS_CHANNELS];
+    ibus_snapshot_init(&snapshot);
+    // uncontended read latency
+    snapshot_pattern(channel, 1);
+    ibus_snapshot_publish(&snapshot, channel, 1);
+    uint64_t t0 = bench_now_ns();
+    for (int i = 0; i < BENCH_SNAPSHOT_FRAMES; i++) {
+        ibus_snapshot_read(&snapshot, &frame);
+    }
+    double idle_ns = (double)(bench_now_ns() - t0) / BENCH_SNAPSHOT_FRAMES;
+    // a writer publishing flat out against concurrent readers
+    pthread_t writer;
+    pthread_t readers[BENCH_SNAPSHOT_READERS];
+    snapshot_reader_t results[BENCH_SNAPSHOT_READERS] = { 0 };
+    ibus_snapshot_init(&snapshot);
+    atomic_store(&snapshot_done, false);
+    for (int i = 0; i < BENCH_SNAPSHOT_READERS; i++) {
+        pthread_create(&readers[i], NULL, snapshot_reader, &results[i]);
+    }
+    pthread_create(&writer, NULL, snapshot_writer, NULL);
+    pthread_join(writer, NULL);
+    size_t reads = 0, torn = 0, backwards = 0;
+    uint64_t ns = 0;
+    for (int i = 0; i < BENCH_SNAPSHOT_READERS; i++) {
+        pthread_join(readers[i], NULL);
+        reads += results[i].reads;
+        torn += results[i].torn;
+        backwards += results[i].backwards;
+        ns += results[i].ns;
+    }
+    printf("snapshot: %.1f ns/read idle, %.1f ns/read contended, %zu reads, %zu torn, %zu out of order\n",
+        idle_ns, reads ? (double)ns / reads : 0.0, reads, torn, backwards);
+    return torn || backwards ? 1 : 0;
+}
+
+static ibus_queue_t queue;
+
+typedef struct {
+    size_t frames;
+    uint64_t period;  // ns between pushes, 0 to push as fast as possible
+} queue_producer_t;
+
+// stands in for core 1, retries a full queue so no frame goes missing
+static void *queue_producer(void *arg) {
+    queue_producer_t *p = arg;
+    ibus_frame_snapshot_t frame = { 0 };
+    uint64_t next = bench_now_ns();
+    for (uint32_t n = 1; n <= p->frames; n++) {
+        if (p->period) {
+            next += p->period;
+            while (bench_now_ns() < next) sched_yield();
+        }
+        frame.frame = n;
+        frame.timestamp = (uint32_t)bench_now_ns();
+        // yield so this also works when both threads share one cpu
+        while (!ibus_queue_push(&queue, &frame)) sched_yield();
+    }
+    return NULL;
+}
+
+// consume frames on this thread, returns the number of gaps in the sequence
+static size_t queue_consume(size_t frames, uint64_t *latency_sum, uint64_t *latency_max) {
+    ibus_frame_snapshot_t frame;
+    size_t gaps = 0;
+    uint32_t last = 0;
+    *latency_sum = 0;
+    *latency_max = 0;
+    while (last < frames) {
+        if (!ibus_queue_pop(&queue, &frame)) {
+            sched_yield();
+            continue;
+        }
+        uint32_t latency = (uint32_t)bench_now_ns() - frame.timestamp;
+        *latency_sum += latency;
+        if (latency > *latency_max) *latency_max = latency;
+        if (frame.frame != last + 1) gaps++;
+        last = frame.frame;
+    }
+    return gaps;
+}
+
+static int suite_queue() {
+    pthread_t producer;
+    uint64_t sum, max;
+    size_t gaps;
+    // throughput, both threads flat out
+    queue_producer_t fast = { BENCH_QUEUE_FRAMES, 0 };
+    ibus_queue_init(&queue);
+    uint64_t t0 = bench_now_ns();
+    pthread_create(&producer, NULL, queue_producer, &fast);
+    gaps = queue_consume(BENCH_QUEUE_FRAMES, &sum, &max);
+    pthread_join(producer, NULL);
+    double rate = BENCH_QUEUE_FRAMES * 1e3 / (bench_now_ns() - t0);
+    printf("queue: %.2f Mframes/s, %zu gaps\n", rate, gaps);
+    // latency, producer paced so the queue is mostly empty
+    queue_producer_t paced = { BENCH_QUEUE_PACED_FRAMES, BENCH_QUEUE_PERIOD_NS };
+    ibus_queue_init(&queue);
+    pthread_create(&producer, NULL, queue_producer, &paced);
+    gaps += queue_consume(BENCH_QUEUE_PACED_FRAMES, &sum, &max);
+    pthread_join(producer, NULL);
+    printf("queue: %.1f ns average handoff latency, %.1f us worst, %zu gaps\n",
+        (double)sum / BENCH_QUEUE_PACED_FRAMES, max / 1e3, gaps);
+    return gaps ? 1 : 0;
+}
+
+// receiver traffic: a servo frame, then sensor polls for addresses 1 and 2
+static const uint8_t sensor_stream[] = {
+    0x20, 0x40, 0xDB, 0x05, 0xDC, 0x05, 0x54, 0x05, 0xDC, 0x05, 0xE8, 0x03, 0xD0, 0x07, 0xD2, 0x05,
+    0xE8, 0x03, 0xDC, 0x05, 0xDC, 0x05, 0xDC, 0x05, 0xDC, 0x05, 0xDC, 0x05, 0xDC, 0x05, 0xDA, 0xF3,
+    0x04, 0x81, 0x7A, 0xFF,
+    0x04, 0x91, 0x6A, 0xFF,
+    0x04, 0xA1, 0x5A, 0xFF,
+    0x04, 0x82, 0x79, 0xFF,
+};
+
+// what a temperature sensor reading 25.0 C at address 1 has to send back
+static const uint8_t sensor_replies[] = {
+    0x04, 0x81, 0x7A, 0xFF,
+    0x06, 0x91, 0x01, 0x02, 0x65, 0xFF,
+    0x06, 0xA1, 0x8A, 0x02, 0xCC, 0xFE,
+};
+
+static int suite_sensor() {
+    ibus_sensor_t sensors[] = {
+        { IBUS_SENSOR_TEMPERATURE, 2, 400 + 250 },
+    };
+    // every 4 byte request in the stream gets timed
+    size_t capacity = (size_t)BENCH_SENSOR_ROUNDS * (sizeof(sensor_stream) / 4);
+    uint64_t *times = malloc(capacity * sizeof(uint64_t));
+    ibus_parser_t parser;
+    uint8_t replies[sizeof(sensor_replies) + IBUS_SENSOR_REPLY_MAX];
+    uint8_t reply[IBUS_SENSOR_REPLY_MAX];
+    size_t n = 0;
+    size_t servo = 0;
+    uint64_t total = 0;
+    size_t requests = 0;
+    ibus_parser_init(&parser);
+    for (int round = 0; round < BENCH_SENSOR_ROUNDS; round++) {
+        for (size_t i = 0; i < sizeof(sensor_stream); i++) {
+            uint64_t t0 = bench_now_ns();
+            if (!ibus_parser_feed(&parser, sensor_stream[i])) continue;
+            if (parser.buffer[1] == IBUS_COMMAND40) {
+                servo++;
+                continue;
+            }
+            // time from the last request byte to a finished reply
+            uint8_t len = ibus_sensor_respond(sensors, 1, parser.buffer, 0, reply);
+            uint64_t t = bench_now_ns() - t0;
+            total += t;
+            if (requests < capacity) times[requests] = t;
+            requests++;
+            if (round == 0 && len && n + len <= sizeof(replies)) {
+                memcpy(replies + n, reply, len);
+                n += len;
+            }
+        }
+    }
+    int wrong = n != sizeof(sensor_replies) || memcmp(replies, sensor_replies, n) != 0;
+    // a request that waited past the window must stay unanswered
+    int late = ibus_sensor_respond(sensors, 1, sensor_stream + 32, IBUS_SENSOR_WINDOW_US + 1, reply) != 0;
+    // the deadline is checked against p99, a host thread can always get
+    // preempted for longer than the window
+    size_t samples = requests < capacity ? requests : capacity;
+    qsort(times, samples, sizeof(uint64_t), bench_compare_u64);
+    uint64_t p99 = times[samples * 99 / 100];
+    uint64_t worst = times[samples - 1];
+    int slow = p99 > IBUS_SENSOR_WINDOW_US * 1000u;
+    printf("sensor: replies %s, late request %s, %zu servo frames, %.1f ns/request, %.1f us p99 %.1f us worst of %d us window\n",
+        wrong ? "WRONG" : "ok", late ? "ANSWERED" : "ignored", servo,
+        (double)total / requests, p99 / 1e3, worst / 1e3, IBUS_SENSOR_WINDOW_US);
+    free(times);
+    return wrong || late || slow;
+}
+
+// the mapping main.c used before the lookup tables
+static uint16_t legacy_normalize(uint16_t value, uint8_t type) {
+    (void)type;
+    return ((value - 1000) / 10);
+}
+
+// keep the compiler from dropping the mapped values
+static volatile int32_t map_sink;
+
+static int suite_map() {
+    static uint16_t frames[1024][IBUS_CHANNELS];
+    ibus_map_curve_t curves[IBUS_CHANNELS];
+    ibus_map_config_t config = IBUS_MAP_DEFAULT;
+    int16_t mapped[IBUS_CHANNELS];
+    int failed = 0;
+    config.deadband = 8;
+    config.expo = 30;
+    for (uint8_t i = 0; i < IBUS_CHANNELS; i++) {
+        ibus_map_configure(&curves[i], &config);
+    }
+    for (int f = 0; f < 1024; f++) {
+        for (uint8_t i = 0; i < IBUS_CHANNELS; i++) {
+            // a few out of range values like a badly trimmed transmitter
+            frames[f][i] = 980 + bench_rand() % 1041;
+        }
+    }
+    // the curve has to hit its end points, be flat in the deadband and
+    // never go backwards
+    const ibus_map_curve_t *c = &curves[0];
+    failed |= ibus_map_apply(c, 1000) != -IBUS_MAP_ONE || ibus_map_apply(c, 2000) != IBUS_MAP_ONE;
+    failed |= ibus_map_apply(c, 1500) != 0 || ibus_map_apply(c, 1492) != 0 || ibus_map_apply(c, 1508) != 0;
+    for (uint16_t v = 900; v < 2100; v++) {
+        failed |= ibus_map_apply(c, v + 1) < ibus_map_apply(c, v);
+    }
+    uint64_t t0 = bench_now_ns();
+    uint64_t c0 = bench_cycles();
+    for (int f = 0; f < BENCH_MAP_FRAMES; f++) {
+        const uint16_t *channel = frames[f & 1023];
+        int32_t sum = 0;
+        for (uint8_t i = 0; i < IBUS_CHANNELS; i++) {
+            sum += legacy_normalize(channel[i], i >= 4);
+        }
+        map_sink = sum;
+    }
+    uint64_t c1 = bench_cycles();
+    uint64_t t1 = bench_now_ns();
+    for (int f = 0; f < BENCH_MAP_FRAMES; f++) {
+        ibus_map_channels(curves, frames[f & 1023], mapped);
+        int32_t sum = 0;
+        for (uint8_t i = 0; i < IBUS_CHANNELS; i++) {
+            sum += mapped[i];
+        }
+        map_sink = sum;
+    }
+    uint64_t c2 = bench_cycles();
+    uint64_t t2 = bench_now_ns();
+    printf("map: curve %s, normalize() %.1f ns %.1f cycles/frame, lut %.1f ns %.1f cycles/frame (%d channels)\n",
+        failed ? "WRONG" : "ok",
+        (double)(t1 - t0) / BENCH_MAP_FRAMES, (double)(c1 - c0) / BENCH_MAP_FRAMES,
+        (double)(t2 - t1) / BENCH_MAP_FRAMES, (double)(c2 - c1) / BENCH_MAP_FRAMES,
+        IBUS_CHANNELS);
+    return failed;
+}
+
+// fake PWM backend, remembers the last pulse of each output and when the
+// last write happened
+typedef struct {
+    uint16_t pulse[BENCH_OUTPUTS];
+    uint64_t written_ns;
+} fake_pwm_t;
+
+static void fake_pwm_write(void *ctx, uint8_t index, uint16_t pulse_us) {
+    fake_pwm_t *pwm = ctx;
+    pwm->pulse[index] = pulse_us;
+    pwm->written_ns = bench_now_ns();
+}
+
+static int suite_output() {
+    static const ibus_output_config_t config[BENCH_OUTPUTS] = {
+        { 0, 1500, 500, 1500 },
+        { 1, 1500, 500, 1500 },
+        { 2, 1500, 500, 1000 },
+        { 3, 1500, 500, 1500 },
+    };
+    fake_pwm_t pwm = { { 0 }, 0 };
+    ibus_output_backend_t backend = { fake_pwm_write, &pwm };
+    ibus_map_curve_t curves[IBUS_CHANNELS];
+    ibus_map_config_t map = IBUS_MAP_DEFAULT;
+    ibus_parser_t parser;
+    ibus_output_t output;
+    uint16_t channel[IBUS_CHANNELS];
+    int16_t mapped[IBUS_CHANNELS];
+    uint8_t frame[IBUS_MAX_LENGTH];
+    for (uint8_t i = 0; i < IBUS_CHANNELS; i++) {
+        ibus_map_configure(&curves[i], &map);
+    }
+    ibus_parser_init(&parser);
+    ibus_output_init(&output, &backend, config, BENCH_OUTPUTS, BENCH_FAILSAFE_US);
+    int failed = !output.failsafe || pwm.pulse[2] != 1000;
+    // latency from the last byte of a frame arriving to the last output
+    // being written, decode and mapping included
+    uint64_t total = 0, worst = 0;
+    uint32_t now_us = 0;
+    for (int f = 0; f < BENCH_OUTPUT_FRAMES; f++) {
+        bench_stream(frame, 1);
+        for (uint8_t i = 0; i < IBUS_MAX_LENGTH - 1; i++) ibus_parser_feed(&parser, frame[i]);
+        uint64_t t0 = bench_now_ns();
+        if (ibus_parser_feed(&parser, frame[IBUS_MAX_LENGTH - 1])) {
+            ibus_decode_channels(parser.buffer, channel);
+            ibus_map_channels(curves, channel, mapped);
+            ibus_output_frame(&output, mapped, now_us += BENCH_FRAME_US);
+        }
+        uint64_t t = pwm.written_ns - t0;
+        total += t;
+        if (t > worst) worst = t;
+    }
+    // the last frame has to show up on the outputs
+    for (uint8_t i = 0; i < BENCH_OUTPUTS; i++) {
+        int32_t expect = 1500 + ((mapped[i] * 500) >> 15);
+        failed |= pwm.pulse[i] != expect;
+    }
+    // link lost: on a simulated clock, check as often as the firmware does
+    // and see how long after the last frame failsafe kicks in
+    uint32_t last_frame = now_us;
+    uint32_t t = now_us;
+    while (!ibus_output_check(&output, t += BENCH_CHECK_US));
+    uint32_t engaged = t - last_frame;
+    failed |= engaged <= BENCH_FAILSAFE_US || engaged > BENCH_FAILSAFE_US + BENCH_CHECK_US;
+    failed |= pwm.pulse[0] != 1500 || pwm.pulse[2] != 1000;
+    // and the next frame takes over again
+    ibus_output_frame(&output, mapped, t + BENCH_FRAME_US);
+    failed |= output.failsafe || ibus_output_check(&output, t + BENCH_FRAME_US + BENCH_CHECK_US);
+    printf("output: %s, frame to output %.1f ns average %.1f us worst, failsafe after %lu us (timeout %d us)\n",
+        failed ? "WRONG" : "ok", (double)total / BENCH_OUTPUT_FRAMES, worst / 1e3,
+        (unsigned long)engaged, BENCH_FAILSAFE_US);
+    return failed;
+}
+
+static int suite_stats() {
+    static ibus_stats_t stats;
+    ibus_stats_report_t report;
+    ibus_stats_record_t record;
+    ibus_parser_t parser;
+    uint8_t frame[IBUS_MAX_LENGTH];
+    size_t sent = 0, corrupted = 0;
+    uint32_t now_us = 0;
+    int failed = 0;
+    // one second of traffic with every tenth frame corrupted
+    ibus_stats_init(&stats);
+    ibus_stats_report_init(&report, now_us);
+    ibus_parser_init(&parser);
+    for (int f = 0; f < 1000000 / BENCH_FRAME_US; f++) {
+        bench_stream(frame, 1);
+        if (f % 10 == 5) {
+            frame[10] ^= 0x01;
+            corrupted++;
+        } else {
+            sent++;
+        }
+        now_us += BENCH_FRAME_US;
+        for (uint8_t i = 0; i < IBUS_MAX_LENGTH; i++) {
+            if (ibus_parser_feed(&parser, frame[i])) ibus_stats_frame(&stats, now_us);
+        }
+        ibus_stats_rx_time(&stats, 3);
+    }
+    ibus_stats_losses_t losses = { .queue_drops = 3, .failsafes = 2, .stream_drops = 1 };
+    ibus_stats_record(&report, &stats, &parser.errors, &losses, now_us, &record);
+    failed |= record.version != IBUS_STATS_VERSION || record.queue_drops != 3 || record.failsafes != 2 || record.stream_drops != 1;
+    // one error per broken frame, the false headers inside it don't count
+    failed |= record.frames != sent || record.chksum_errors != corrupted || record.resyncs != corrupted;
+    failed |= record.frame_rate != sent * 1000000 / now_us;
+    // gaps are one or two frame periods, 7 ms and 14 ms
+    failed |= record.gap_hist[ibus_stats_bucket(BENCH_FRAME_US)] + record.gap_hist[ibus_stats_bucket(2 * BENCH_FRAME_US)] != sent - 1;
+    failed |= record.rx_hist[ibus_stats_bucket(3)] != 1000000 / BENCH_FRAME_US;
+    // histograms restart with every record
+    ibus_stats_record(&report, &stats, &parser.errors, &losses, now_us + 1000000, &record);
+    failed |= record.frame_rate != 0 || record.gap_hist[ibus_stats_bucket(BENCH_FRAME_US)] != 0;
+    // overhead of the two calls the receive path makes per frame
+    uint64_t t0 = bench_now_ns();
+    for (uint32_t i = 0; i < BENCH_STATS_FRAMES; i++) {
+        ibus_stats_frame(&stats, i * BENCH_FRAME_US);
+        ibus_stats_rx_time(&stats, i & 63);
+    }
+    uint64_t t1 = bench_now_ns();
+    printf("stats: %s, %zu byte record, %.1f ns/frame overhead\n",
+        failed ? "WRONG" : "ok", sizeof(record), (double)(t1 - t0) / BENCH_STATS_FRAMES);
+    return failed;
+}
+
+static int suite_stream() {
+    uint8_t *data = malloc((size_t)BENCH_STREAM_RECORDS * IBUS_STREAM_MAX);
+    ibus_frame_snapshot_t frame, back;
+    ibus_stream_parser_t parser;
+    size_t n = 0, corrupted = 0, received = 0, wrong = 0;
+    uint64_t busy = 0;
+    for (uint32_t r = 0; r < BENCH_STREAM_RECORDS; r++) {
+        frame.frame = r;
+        frame.timestamp = r * BENCH_FRAME_US;
+        for (uint8_t i = 0; i < IBUS_CHANNELS; i++) {
+            frame.channel[i] = (r * 31 + i * 97) & 0x0FFF;
+        }
+        uint64_t t0 = bench_now_ns();
+        uint8_t len = ibus_stream_frame(data + n, &frame);
+        busy += bench_now_ns() - t0;
+        // flip a bit in one record out of a hundred
+        if (r % 100 == 50) {
+            data[n + bench_rand() % len] ^= 1 << (bench_rand() % 8);
+            corrupted++;
+        }
+        n += len;
+    }
+    // every intact record has to come back with the channels it went out with
+    ibus_stream_parser_init(&parser);
+    for (size_t i = 0; i < n; i++) {
+        if (!ibus_stream_parser_feed(&parser, data[i])) continue;
+        ibus_stream_unpack_frame(parser.buffer, &back);
+        received++;
+        // the sequence number is 16 bits, the timestamp has the full count
+        uint32_t r = back.timestamp / BENCH_FRAME_US;
+        if ((uint16_t)r != back.frame) wrong++;
+        for (uint8_t c = 0; c < IBUS_CHANNELS; c++) {
+            if (back.channel[c] != ((r * 31 + c * 97) & 0x0FFF)) wrong++;
+        }
+    }
+    printf("stream: %zu/%zu intact records, %zu bad, %lu crc errors, %.1f ns/record encode, %d byte frame record\n",
+        received, (size_t)BENCH_STREAM_RECORDS - corrupted, wrong, (unsigned long)parser.crc_errors,
+        (double)busy / BENCH_STREAM_RECORDS, ibus_stream_frame(data, &frame));
+    free(data);
+    return received != BENCH_STREAM_RECORDS - corrupted || wrong;
+}
+
+static const struct {
+    const char *name;
+    int (*run)();
+} suites[] = {
+    { "parse", suite_parse },
+    { "flips", suite_flips },
+    { "drops", suite_drops },
+    { "garbage", suite_garbage },
+    { "truncated", suite_truncated },
+    { "ring", suite_ring },
+    { "ring_linerate", suite_ring_linerate },
+    { "snapshot", suite_snapshot },
+    { "queue", suite_queue },
+    { "sensor", suite_sensor },
+    { "map", suite_map },
+    { "output", suite_output },
+    { "stats", suite_stats },
+    { "stream", suite_stream },
+};
+
+static const struct {
+    const char *name;
+    uint32_t *value;
+} options[] = {
+    { "--seed=", &sim_config.seed },
+    { "--baud=", &sim_config.baud },
+    { "--frame-us=", &sim_config.frame_us },
+    { "--flip-ppm=", &sim_config.flip_ppm },
+    { "--drop-ppm=", &sim_config.drop_ppm },
+    { "--noise-ppm=", &sim_config.noise_ppm },
+    { "--truncate-ppm=", &sim_config.truncate_ppm },
+    { "--min-mbps=", &sim_min_mbps },
+};
+
+// options start with --, anything else picks a suite
+static int bench_option(const char *arg) {
+    for (size_t i = 0; i < sizeof(options) / sizeof(options[0]); i++) {
+        size_t len = strlen(options[i].name);
+        if (strncmp(arg, options[i].name, len) == 0) {
+            *options[i].value = strtoul(arg + len, NULL, 0);
+            return 1;
+        }
+    }
+    if (strncmp(arg, "--frames=", 9) == 0) {
+        sim_frames = strtoul(arg + 9, NULL, 0);
+        return 1;
+    }
+    if (strncmp(arg, "--max-latency-ns=", 17) == 0) {
+        sim_max_latency_ns = strtoull(arg + 17, NULL, 0);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int failed = 0;
+    int picked = 0;
+    for (int a = 1; a < argc; a++) {
+        if (strncmp(argv[a], "--", 2) != 0) {
+            picked = 1;
+        } else if (!bench_option(argv[a])) {
+            fprintf(stderr, "unknown option %s\n", argv[a]);
+            return 2;
+        }
+    }
+    if (!sim_config.baud || !sim_frames) {
+        fprintf(stderr, "baud and frames have to be positive\n");
+        return 2;
+    }
+    for (size_t i = 0; i < sizeof(suites) / sizeof(suites[0]); i++) {
+        int selected = !picked;
+        for (int a = 1; a < argc; a++) {
+            if (strcmp(argv[a], suites[i].name) == 0) selected = 1;
+        }
+        if (selected) failed |= suites[i].run();
+    }
+    return failed;
+}
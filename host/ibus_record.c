@@ -0,0 +1,154 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "ibus.h"
+#include "ibus_stream.h"
+#include "ibus_stats.h"
+
+/*
+  Read the firmware's USB record stream, print every record as a CSV line
+  and optionally keep the raw bytes for ibus_replay.
+
+    ibus_record /dev/ttyACM0 -o capture.bin > capture.csv
+
+  With -r the device is a serial adapter listening on the iBUS wire itself,
+  set to 115200 baud. The raw bytes are kept for ibus_replay -r and every
+  servo frame is printed with the host time it was read at, in microseconds.
+
+    ibus_record -r /dev/ttyUSB0 -o wire.bin > wire.csv
+
+  Use - to read from stdin. Stops at end of input or on Ctrl-C.
+ */
+
+static volatile sig_atomic_t stop = 0;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+static void print_frame(const uint8_t *record) {
+    ibus_frame_snapshot_t frame;
+    uint8_t count = ibus_stream_unpack_frame(record, &frame);
+    printf("frame,%lu,%lu", (unsigned long)frame.frame, (unsigned long)frame.timestamp);
+    for (uint8_t i = 0; i < count && i < IBUS_CHANNELS; i++) {
+        printf(",%u", frame.channel[i]);
+    }
+    printf("\n");
+}
+
+static void print_stats(const uint8_t *record) {
+    ibus_stats_record_t stats;
+    // a record from other firmware has a different layout, don't guess
+    if (record[3] != sizeof(stats) || record[IBUS_STREAM_HEADER] != IBUS_STATS_VERSION) {
+        fprintf(stderr, "stats record version %u, %u bytes, expected version %u, %zu bytes\n",
+            record[IBUS_STREAM_HEADER], record[3], IBUS_STATS_VERSION, sizeof(stats));
+        return;
+    }
+    memcpy(&stats, record + IBUS_STREAM_HEADER, sizeof(stats));
+    printf("stats,%u,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%u", stats.frame_rate, (unsigned long)stats.frames,
+        (unsigned long)stats.chksum_errors, (unsigned long)stats.resyncs,
+        (unsigned long)stats.overruns, (unsigned long)stats.queue_drops,
+        (unsigned long)stats.failsafes, (unsigned long)stats.stream_drops, stats.rx_max_us);
+    for (uint8_t i = 0; i < IBUS_STATS_BUCKETS; i++) printf(",%u", stats.gap_hist[i]);
+    for (uint8_t i = 0; i < IBUS_STATS_BUCKETS; i++) printf(",%u", stats.rx_hist[i]);
+    printf("\n");
+}
+
+static uint64_t now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000;
+}
+
+int main(int argc, char **argv) {
+    const char *device = NULL;
+    const char *capture = NULL;
+    int raw = 0;
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "-o") == 0 && a + 1 < argc) capture = argv[++a];
+        else if (strcmp(argv[a], "-r") == 0) raw = 1;
+        else device = argv[a];
+    }
+    if (!device) {
+        fprintf(stderr, "usage: %s [-r] <device|-> [-o capture.bin]\n", argv[0]);
+        return 2;
+    }
+    int fd = strcmp(device, "-") == 0 ? STDIN_FILENO : open(device, O_RDONLY | O_NOCTTY);
+    if (fd < 0) {
+        fprintf(stderr, "%s: %s\n", device, strerror(errno));
+        return 1;
+    }
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        // a serial port, make sure nothing gets translated
+        cfmakeraw(&tio);
+        if (raw) {
+            cfsetispeed(&tio, B115200);
+            cfsetospeed(&tio, B115200);
+        }
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    FILE *out = capture ? fopen(capture, "wb") : NULL;
+    if (capture && !out) {
+        fprintf(stderr, "%s: %s\n", capture, strerror(errno));
+        return 1;
+    }
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+
+    ibus_stream_parser_t parser;
+    ibus_parser_t wire;
+    uint16_t channel[IBUS_CHANNELS];
+    ibus_stream_parser_init(&parser);
+    ibus_parser_init(&wire);
+    uint64_t start = now_us();
+    unsigned long frames = 0, gaps = 0;
+    uint16_t last = 0;
+    uint8_t buffer[4096];
+    while (!stop) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        if (out) fwrite(buffer, 1, n, out);
+        if (raw) {
+            uint64_t t = now_us() - start;
+            for (ssize_t i = 0; i < n; i++) {
+                if (!ibus_parser_feed(&wire, buffer[i]) || wire.buffer[1] != IBUS_COMMAND40) continue;
+                ibus_decode_channels(wire.buffer, channel);
+                printf("frame,%lu,%llu", frames++, (unsigned long long)t);
+                for (uint8_t c = 0; c < IBUS_CHANNELS; c++) printf(",%u", channel[c]);
+                printf("\n");
+            }
+            continue;
+        }
+        for (ssize_t i = 0; i < n; i++) {
+            if (!ibus_stream_parser_feed(&parser, buffer[i])) continue;
+            if (parser.buffer[2] == IBUS_STREAM_FRAME) {
+                uint16_t seq = parser.buffer[IBUS_STREAM_HEADER] | (parser.buffer[IBUS_STREAM_HEADER + 1] << 8);
+                // a gap means the firmware dropped records, the host was too slow
+                if (frames++ && seq != (uint16_t)(last + 1)) gaps++;
+                last = seq;
+                print_frame(parser.buffer);
+            } else if (parser.buffer[2] == IBUS_STREAM_STATS) {
+                print_stats(parser.buffer);
+            }
+        }
+    }
+    if (out) fclose(out);
+    if (raw) {
+        fprintf(stderr, "%lu frames, %lu checksum errors, %lu resyncs\n", frames,
+            (unsigned long)wire.errors.chksum_errors, (unsigned long)wire.errors.resyncs);
+    } else {
+        fprintf(stderr, "%lu frames, %lu sequence gaps, %lu crc errors\n",
+            frames, gaps, (unsigned long)parser.crc_errors);
+    }
+    return 0;
+}
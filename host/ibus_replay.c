@@ -0,0 +1,140 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include "ibus.h"
+#include "ibus_stream.h"
+#include "ibus_stats.h"
+
+/*
+  Feed a capture back through the receive path.
+
+    ibus_replay capture.bin [-w ibus.bin]
+    ibus_replay -r wire.bin > frames.csv
+
+  A record capture made with ibus_record only holds frames the firmware
+  already decoded. Every frame record is turned back into a clean iBUS frame,
+  run through the parser and decoder and compared with the recorded
+  channels, and the record timestamps drive an offline stats record of the
+  link. That checks encode and decode against each other and gives timing
+  and gap analysis, it never sees a broken frame. -w keeps the rebuilt iBUS
+  byte stream. Exits with 1 if any frame decodes differently.
+
+  -r replays a raw capture of the iBUS wire instead, made with ibus_record -r
+  through a serial adapter, byte for byte through the parser, noise, broken
+  frames and all. Every decoded servo frame is printed as a CSV line with its
+  byte offset, the link errors go to stderr. Diff the output against an
+  earlier run to use a wire capture as a regression test of resync and error
+  handling, ctest does that with host/testdata/wire.bin.
+ */
+
+// raw wire bytes straight into the parser
+static int replay_raw(FILE *in) {
+    ibus_parser_t parser;
+    uint16_t channel[IBUS_CHANNELS];
+    unsigned long offset = 0, frames = 0, polls = 0;
+    int c;
+    ibus_parser_init(&parser);
+    while ((c = fgetc(in)) != EOF) {
+        offset++;
+        if (!ibus_parser_feed(&parser, c)) continue;
+        if (parser.buffer[1] != IBUS_COMMAND40) {
+            polls++; // sensor traffic, only counted
+            continue;
+        }
+        ibus_decode_channels(parser.buffer, channel);
+        printf("frame,%lu,%lu", frames++, offset);
+        for (uint8_t i = 0; i < IBUS_CHANNELS; i++) printf(",%u", channel[i]);
+        printf("\n");
+    }
+    fprintf(stderr, "%lu bytes, %lu frames, %lu sensor frames, %lu checksum errors, %lu resyncs\n",
+        offset, frames, polls, (unsigned long)parser.errors.chksum_errors,
+        (unsigned long)parser.errors.resyncs);
+    return 0;
+}
+
+// frame records rebuilt into iBUS frames
+static int replay_records(FILE *in, FILE *out) {
+    ibus_stream_parser_t stream;
+    ibus_parser_t parser;
+    ibus_stats_t stats;
+    ibus_stats_report_t report;
+    ibus_stats_record_t record;
+    ibus_frame_snapshot_t frame;
+    uint16_t channel[IBUS_CHANNELS];
+    uint8_t bytes[IBUS_MAX_LENGTH];
+    unsigned long frames = 0, decoded = 0, mismatches = 0, gaps = 0;
+    uint32_t first = 0, last_ts = 0;
+    uint16_t last = 0;
+    int c;
+    ibus_stream_parser_init(&stream);
+    ibus_parser_init(&parser);
+    ibus_stats_init(&stats);
+    while ((c = fgetc(in)) != EOF) {
+        if (!ibus_stream_parser_feed(&stream, c) || stream.buffer[2] != IBUS_STREAM_FRAME) continue;
+        uint8_t count = ibus_stream_unpack_frame(stream.buffer, &frame);
+        if (count > IBUS_CHANNELS) count = IBUS_CHANNELS;
+        if (frames++ == 0) {
+            first = frame.timestamp;
+            ibus_stats_report_init(&report, first);
+        } else if ((uint16_t)frame.frame != (uint16_t)(last + 1)) {
+            gaps++;
+        }
+        last = frame.frame;
+        last_ts = frame.timestamp;
+        // rebuild the wire bytes and push them through the parser
+        uint8_t len = ibus_encode_channels(bytes, frame.channel, count);
+        if (out) fwrite(bytes, 1, len, out);
+        for (uint8_t i = 0; i < len; i++) {
+            if (!ibus_parser_feed(&parser, bytes[i])) continue;
+            decoded++;
+            ibus_stats_frame(&stats, frame.timestamp);
+            ibus_decode_channels(parser.buffer, channel);
+            if (memcmp(channel, frame.channel, count * sizeof(channel[0])) != 0) {
+                mismatches++;
+                fprintf(stderr, "frame %lu decodes differently\n", (unsigned long)frame.frame);
+            }
+        }
+    }
+    if (frames) {
+        ibus_stats_losses_t losses = { 0 };
+        ibus_stats_record(&report, &stats, &parser.errors, &losses, last_ts, &record);
+        printf("%lu frames over %.3f s, %u frames/s, %lu sequence gaps, %lu crc errors\n",
+            frames, (last_ts - first) / 1e6, record.frame_rate, gaps, (unsigned long)stream.crc_errors);
+        printf("gap histogram (us):");
+        for (uint8_t i = 0; i < IBUS_STATS_BUCKETS; i++) {
+            if (record.gap_hist[i]) printf(" <%u:%u", 1u << i, record.gap_hist[i]);
+        }
+        printf("\n");
+    }
+    printf("%lu/%lu frames decoded, %lu mismatches\n", decoded, frames, mismatches);
+    return mismatches || decoded != frames ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+    const char *capture = NULL;
+    const char *rebuilt = NULL;
+    int raw = 0;
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "-w") == 0 && a + 1 < argc) rebuilt = argv[++a];
+        else if (strcmp(argv[a], "-r") == 0) raw = 1;
+        else capture = argv[a];
+    }
+    if (!capture || (raw && rebuilt)) {
+        fprintf(stderr, "usage: %s <capture.bin> [-w ibus.bin]\n       %s -r <wire.bin>\n", argv[0], argv[0]);
+        return 2;
+    }
+    FILE *in = fopen(capture, "rb");
+    if (!in) {
+        fprintf(stderr, "%s: %s\n", capture, strerror(errno));
+        return 1;
+    }
+    FILE *out = rebuilt ? fopen(rebuilt, "wb") : NULL;
+    if (rebuilt && !out) {
+        fprintf(stderr, "%s: %s\n", rebuilt, strerror(errno));
+        return 1;
+    }
+    int result = raw ? replay_raw(in) : replay_records(in, out);
+    fclose(in);
+    if (out) fclose(out);
+    return result;
+}
@@ -0,0 +1,16 @@
+# ctest script: replay a raw wire capture and compare the decoded frames and
+# the link error summary with the expected output. Takes REPLAY, CAPTURE,
+# FRAMES and ERRORS as -D definitions.
+execute_process(COMMAND ${REPLAY} -r ${CAPTURE}
+    OUTPUT_VARIABLE frames ERROR_VARIABLE errors RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "ibus_replay failed (${result}): ${errors}")
+endif()
+file(READ ${FRAMES} expected_frames)
+file(READ ${ERRORS} expected_errors)
+if(NOT frames STREQUAL expected_frames)
+    message(FATAL_ERROR "decoded frames differ from ${FRAMES}:\n${frames}")
+endif()
+if(NOT errors STREQUAL expected_errors)
+    message(FATAL_ERROR "link errors differ from ${ERRORS}:\n${errors}")
+endif()
@@ -0,0 +1,79 @@
+#include "ibus_sim.h"
+
+// xorshift, repeatable for a given seed
+static uint32_t ibus_sim_rand(ibus_sim_t *sim) {
+    sim->rand ^= sim->rand << 13;
+    sim->rand ^= sim->rand >> 17;
+    sim->rand ^= sim->rand << 5;
+    return sim->rand;
+}
+
+static bool ibus_sim_chance(ibus_sim_t *sim, uint32_t ppm) {
+    return ppm && ibus_sim_rand(sim) % 1000000 < ppm;
+}
+
+// move the sticks a little and build the next frame
+static void ibus_sim_frame(ibus_sim_t *sim) {
+    for (uint8_t i = 0; i < IBUS_CHANNELS; i++) {
+        int32_t value = sim->channel[i] + (int32_t)(ibus_sim_rand(sim) % 41) - 20;
+        if (value < 1000) value = 1000;
+        if (value > 2000) value = 2000;
+        sim->channel[i] = value;
+    }
+    sim->len = ibus_encode_channels(sim->frame, sim->channel, IBUS_CHANNELS);
+    sim->pos = 0;
+    sim->damaged = false;
+    if (ibus_sim_chance(sim, sim->config.truncate_ppm)) {
+        sim->len = 1 + ibus_sim_rand(sim) % (IBUS_MAX_LENGTH - 1);
+        sim->damaged = true;
+        sim->truncated++;
+    }
+    sim->frames++;
+}
+
+void ibus_sim_init(ibus_sim_t *sim, const ibus_sim_config_t *config) {
+    sim->config = *config;
+    sim->rand = config->seed ? config->seed : 1;
+    sim->byte_ns = 10ull * 1000000000 / config->baud;
+    sim->time_ns = 0;
+    sim->frame_ns = 0;
+    sim->frames = sim->intact = 0;
+    sim->flips = sim->drops = sim->noise = sim->truncated = 0;
+    for (uint8_t i = 0; i < IBUS_MAX_CHANNELS; i++) {
+        sim->channel[i] = IBUS_CHANNEL_CENTER;
+    }
+    ibus_sim_frame(sim);
+}
+
+uint8_t ibus_sim_next(ibus_sim_t *sim, uint64_t *time_ns) {
+    while (true) {
+        if (sim->pos == sim->len) {
+            if (!sim->damaged) sim->intact++;
+            // the line idles until the next frame is due
+            sim->frame_ns += sim->config.frame_us * 1000ull;
+            if (sim->frame_ns > sim->time_ns) sim->time_ns = sim->frame_ns;
+            ibus_sim_frame(sim);
+        }
+        sim->time_ns += sim->byte_ns;
+        if (ibus_sim_chance(sim, sim->config.noise_ppm)) {
+            sim->noise++;
+            // between frames it is just line noise the parser has to skip
+            if (sim->pos) sim->damaged = true;
+            *time_ns = sim->time_ns;
+            return ibus_sim_rand(sim);
+        }
+        uint8_t value = sim->frame[sim->pos++];
+        if (ibus_sim_chance(sim, sim->config.drop_ppm)) {
+            sim->drops++;
+            sim->damaged = true;
+            continue;
+        }
+        if (ibus_sim_chance(sim, sim->config.flip_ppm)) {
+            value ^= 1 << (ibus_sim_rand(sim) % 8);
+            sim->flips++;
+            sim->damaged = true;
+        }
+        *time_ns = sim->time_ns;
+        return value;
+    }
+}
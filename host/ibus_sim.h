@@ -0,0 +1,60 @@
+#ifndef IBUS_SIM_H
+#define IBUS_SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ibus.h"
+
+/*
+  Simulated receiver UART for the host build. Produces servo frames the way
+  a receiver does, one every frame_us at the configured baud rate, with the
+  sticks wandering around. Errors are injected per byte or per frame with
+  the given probabilities in parts per million. Every byte comes with the
+  simulated time it finishes arriving, so rates and gaps are realistic even
+  though nothing runs in real time.
+ */
+
+typedef struct {
+    uint32_t seed;
+    uint32_t baud;         // 8N1, ten bit times per byte
+    uint32_t frame_us;     // time between frame starts
+    uint32_t flip_ppm;     // byte has one bit flipped
+    uint32_t drop_ppm;     // byte never arrives
+    uint32_t noise_ppm;    // a random byte is inserted before this one,
+                           // harmless to a frame when it lands in between
+    uint32_t truncate_ppm; // frame is cut short, the rest never sent
+} ibus_sim_config_t;
+
+#define IBUS_SIM_DEFAULT { 0x1B05, 115200, 7000, 0, 0, 0, 0 }
+
+typedef struct {
+    ibus_sim_config_t config;
+    uint32_t rand;
+    uint64_t time_ns;      // arrival time of the last byte handed out
+    uint64_t frame_ns;     // start time of the current frame
+    uint64_t byte_ns;
+    uint16_t channel[IBUS_MAX_CHANNELS];
+    uint8_t frame[IBUS_MAX_LENGTH];
+    uint8_t pos;
+    uint8_t len;           // bytes of the current frame that get sent
+    bool damaged;          // current frame has an error injected
+    // what was sent so far
+    uint32_t frames;
+    uint32_t intact;       // frames sent without any error
+    uint32_t flips;
+    uint32_t drops;
+    uint32_t noise;
+    uint32_t truncated;
+} ibus_sim_t;
+
+void ibus_sim_init(ibus_sim_t *sim, const ibus_sim_config_t *config);
+
+// next byte on the wire and the simulated time it arrives
+uint8_t ibus_sim_next(ibus_sim_t *sim, uint64_t *time_ns);
+
+// channel values of the frame currently being sent
+static inline const uint16_t *ibus_sim_channels(const ibus_sim_t *sim) {
+    return sim->channel;
+}
+
+#endif
@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <string.h>
+#include "ibus.h"
+#include "ibus_ring.h"
+
+/*
+  Pass/fail checks of the parser's and the ring's resync behaviour on hand
+  built byte streams, run by ctest. Every case knows exactly which frames
+  and errors have to come out of its stream.
+ */
+
+#define TEST_MAX_FRAMES 4
+
+typedef struct {
+    size_t frames;
+    uint16_t channel[TEST_MAX_FRAMES][IBUS_CHANNELS];
+    ibus_errors_t errors;
+} test_result_t;
+
+// channel values that differ per frame so a mixed up frame is spotted
+static void test_frame(uint8_t *frame, uint16_t base) {
+    uint16_t channel[IBUS_CHANNELS];
+    for (uint8_t i = 0; i < IBUS_CHANNELS; i++) {
+        channel[i] = base + i * 37;
+    }
+    ibus_encode_channels(frame, channel, IBUS_CHANNELS);
+}
+
+static void test_feed(const uint8_t *data, size_t n, test_result_t *result) {
+    ibus_parser_t parser;
+    ibus_parser_init(&parser);
+    result->frames = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (!ibus_parser_feed(&parser, data[i])) continue;
+        if (result->frames < TEST_MAX_FRAMES) {
+            ibus_decode_channels(parser.buffer, result->channel[result->frames]);
+        }
+        result->frames++;
+    }
+    result->errors = parser.errors;
+}
+
+// exactly one frame came out and it is the one built from base
+static int test_only(const test_result_t *result, uint16_t base) {
+    if (result->frames != 1) return 1;
+    for (uint8_t i = 0; i < IBUS_CHANNELS; i++) {
+        if (result->channel[0][i] != base + i * 37) return 1;
+    }
+    return 0;
+}
+
+static int test_clean() {
+    uint8_t data[2 * IBUS_MAX_LENGTH];
+    test_result_t result;
+    test_frame(data, 1100);
+    test_frame(data + IBUS_MAX_LENGTH, 1200);
+    test_feed(data, sizeof(data), &result);
+    return result.frames != 2 || result.channel[1][0] != 1200 ||
+           result.errors.chksum_errors || result.errors.resyncs;
+}
+
+static int test_noise_length() {
+    // a noise byte that looks like a length starts a bogus frame, which
+    // swallows the real header and has to give it back
+    uint8_t data[1 + IBUS_MAX_LENGTH];
+    test_result_t result;
+    int failed = 0;
+    for (uint8_t noise = IBUS_OVERHEAD + 1; noise <= IBUS_MAX_LENGTH; noise++) {
+        data[0] = noise;
+        test_frame(data + 1, 1300);
+        test_feed(data, sizeof(data), &result);
+        if (test_only(&result, 1300)) {
+            printf("noise_length: frame lost behind 0x%02X\n", noise);
+            failed = 1;
+        }
+    }
+    return failed;
+}
+
+static int test_bad_command() {
+    // 0x20 must be followed by 0x40, even with a checksum that adds up
+    uint8_t data[2 * IBUS_MAX_LENGTH];
+    test_result_t result;
+    test_frame(data, 1400);
+    data[1] = IBUS_COMMAND40 + 1;
+    uint16_t chksum = data[IBUS_MAX_LENGTH - 2] | (data[IBUS_MAX_LENGTH - 1] << 8);
+    chksum--;
+    data[IBUS_MAX_LENGTH - 2] = chksum & 0xFF;
+    data[IBUS_MAX_LENGTH - 1] = chksum >> 8;
+    test_feed(data, IBUS_MAX_LENGTH, &result);
+    if (result.frames != 0 || result.errors.resyncs == 0) return 1;
+    // and a good frame right after it still gets through
+    test_frame(data + IBUS_MAX_LENGTH, 1500);
+    test_feed(data, sizeof(data), &result);
+    return test_only(&result, 1500);
+}
+
+static int test_truncated() {
+    // the tail of the first frame never arrives
+    uint8_t data[2 * IBUS_MAX_LENGTH];
+    test_result_t result;
+    int failed = 0;
+    for (uint8_t cut = 1; cut < IBUS_MAX_LENGTH; cut++) {
+        test_frame(data, 1600);
+        test_frame(data + cut, 1700);
+        test_feed(data, cut + IBUS_MAX_LENGTH, &result);
+        if (test_only(&result, 1700)) {
+            printf("truncated: frame lost after %u bytes\n", cut);
+            failed = 1;
+        }
+    }
+    return failed;
+}
+
+static int test_hidden_header() {
+    // a false 0x20 0x40 header takes in the start of the real frame, the
+    // real header sits inside the bytes that fail the checksum
+    uint8_t data[7 + IBUS_MAX_LENGTH] = { IBUS_MAX_LENGTH, IBUS_COMMAND40, 1, 2, 3, 4, 5 };
+    test_result_t result;
+    test_frame(data + 7, 1800);
+    test_feed(data, sizeof(data), &result);
+    return test_only(&result, 1800) || result.errors.chksum_errors != 1;
+}
+
+// the same stream through a ring, written in one go
+static void test_ring(const uint8_t *data, size_t n, test_result_t *result) {
+    static uint8_t ring_data[256];
+    ibus_ring_t ring;
+    const uint8_t *frame;
+    ibus_ring_init(&ring, ring_data, sizeof(ring_data));
+    memcpy(ring_data, data, n);
+    result->frames = 0;
+    while (ibus_ring_next(&ring, n, &frame)) {
+        if (result->frames < TEST_MAX_FRAMES) {
+            ibus_decode_channels(frame, result->channel[result->frames]);
+        }
+        result->frames++;
+    }
+    result->errors = ring.errors;
+}
+
+static int test_one_error() {
+    // a bit flip anywhere after the header of one frame out of five costs
+    // that frame and counts exactly one checksum error
+    uint8_t data[5 * IBUS_MAX_LENGTH];
+    test_result_t result;
+    int failed = 0;
+    for (uint8_t pos = 2; pos < IBUS_MAX_LENGTH; pos++) {
+        for (uint8_t f = 0; f < 5; f++) test_frame(data + f * IBUS_MAX_LENGTH, 1000 + f * 100);
+        data[2 * IBUS_MAX_LENGTH + pos] ^= 0x01;
+        test_feed(data, sizeof(data), &result);
+        if (result.frames != 4 || result.errors.chksum_errors != 1 || result.errors.resyncs != 1) {
+            printf("one_error: parser %zu frames %u errors %u resyncs, flip at %u\n", result.frames,
+                result.errors.chksum_errors, result.errors.resyncs, pos);
+            failed = 1;
+        }
+        test_ring(data, sizeof(data), &result);
+        if (result.frames != 4 || result.errors.chksum_errors != 1 || result.errors.resyncs != 1) {
+            printf("one_error: ring %zu frames %u errors %u resyncs, flip at %u\n", result.frames,
+                result.errors.chksum_errors, result.errors.resyncs, pos);
+            failed = 1;
+        }
+    }
+    return failed;
+}
+
+static int test_lap() {
+    // the consumer misses more than a ring's worth of frames, none of them
+    // may come out but the ones written after the lap was noticed must
+    static uint8_t ring_data[256];
+    uint8_t frame[IBUS_MAX_LENGTH];
+    uint16_t channel[IBUS_CHANNELS];
+    ibus_ring_t ring;
+    const uint8_t *out;
+    uint32_t written = 0;
+    size_t frames = 0;
+    int failed = 0;
+    ibus_ring_init(&ring, ring_data, sizeof(ring_data));
+    for (uint16_t f = 0; f < 20; f++) {
+        test_frame(frame, 1000 + f * 10);
+        for (uint8_t i = 0; i < IBUS_MAX_LENGTH; i++) {
+            ring_data[written++ % sizeof(ring_data)] = frame[i];
+        }
+        // polls after the first frame and then only after the last two
+        if (f != 0 && f < 18) continue;
+        while (ibus_ring_next(&ring, written, &out)) {
+            ibus_decode_channels(out, channel);
+            if (channel[0] != (frames ? 1190 : 1000)) failed = 1;
+            frames++;
+        }
+    }
+    return failed || frames != 2 || ring.errors.overruns != 1 ||
+           ring.errors.chksum_errors || ring.errors.resyncs;
+}
+
+static const struct {
+    const char *name;
+    int (*run)();
+} tests[] = {
+    { "clean", test_clean },
+    { "noise_length", test_noise_length },
+    { "bad_command", test_bad_command },
+    { "truncated", test_truncated },
+    { "hidden_header", test_hidden_header },
+    { "one_error", test_one_error },
+    { "lap", test_lap },
+};
+
+int main() {
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        int result = tests[i].run();
+        printf("%s: %s\n", tests[i].name, result ? "FAILED" : "ok");
+        failed |= result;
+    }
+    return failed;
+}
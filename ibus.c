@@ -0,0 +1,119 @@
+#include <string.h>
+#include "ibus.h"
+
+void ibus_parser_init(ibus_parser_t *parser) {
+    parser->skip = 0;
+    parser->ptr = 0;
+    parser->len = 0;
+    parser->chksum = 0xFFFF;
+    parser->synced = true;
+    parser->errors.chksum_errors = 0;
+    parser->errors.resyncs = 0;
+    parser->errors.overruns = 0;
+}
+
+// drop the frame in progress, the next byte is treated as a header
+static void ibus_parser_restart(ibus_parser_t *parser) {
+    parser->ptr = 0;
+    parser->len = 0;
+    parser->chksum = 0xFFFF;
+}
+
+// start a new frame from the bytes at the end of the buffer. Called after a
+// checksum failure so a header hidden inside the broken frame isn't lost.
+static void ibus_parser_resync(ibus_parser_t *parser, uint8_t from) {
+    uint8_t end = parser->ptr;
+    for (uint8_t i = from; i < end; i++) {
+        uint8_t fb = parser->buffer[i];
+        uint8_t n = end - i;
+        // candidate must be a valid length that isn't already complete
+        if (!ibus_valid_length(fb) || n >= fb) continue;
+        // a full size frame is always a servo command
+        if (fb == IBUS_MAX_LENGTH && n > 1 && parser->buffer[i + 1] != IBUS_COMMAND40) continue;
+        memmove(parser->buffer, parser->buffer + i, n);
+        parser->ptr = n;
+        parser->len = fb;
+        parser->chksum = 0xFFFF;
+        for (uint8_t j = 0; j < n && j < fb - 2; j++) {
+            parser->chksum -= parser->buffer[j];
+        }
+        return;
+    }
+    ibus_parser_restart(parser);
+}
+
+bool ibus_parser_feed(ibus_parser_t *parser, uint8_t value) {
+    if (parser->skip) {
+        parser->skip--; // echo of our own transmission
+        return false;
+    }
+    if (parser->ptr == 0) {
+        // waiting for the length byte, anything else is line noise
+        if (!ibus_valid_length(value)) return false;
+        parser->len = value;
+        parser->chksum = 0xFFFF - value;
+        parser->buffer[parser->ptr++] = value;
+        return false;
+    }
+    if (parser->ptr == 1 && parser->len == IBUS_MAX_LENGTH && value != IBUS_COMMAND40) {
+        // 0x20 not followed by 0x40, not a header after all
+        if (parser->synced) parser->errors.resyncs++;
+        parser->synced = false;
+        ibus_parser_restart(parser);
+        return ibus_parser_feed(parser, value);
+    }
+    parser->buffer[parser->ptr++] = value;
+    if (parser->ptr <= parser->len - 2) {
+        parser->chksum -= value; // data byte
+        return false;
+    }
+    if (parser->ptr < parser->len) return false; // checksum low byte
+    // frame complete, compare against the transmitted checksum
+    uint16_t rx = parser->buffer[parser->len - 2] | (parser->buffer[parser->len - 1] << 8);
+    if (parser->chksum == rx) {
+        parser->ptr = 0;
+        parser->synced = true;
+        return true;
+    }
+    if (parser->synced) {
+        parser->errors.chksum_errors++;
+        parser->errors.resyncs++;
+    }
+    parser->synced = false;
+    ibus_parser_resync(parser, 1);
+    return false;
+}
+
+void ibus_decode_channels(const uint8_t *frame, uint16_t *channel) {
+    // channel data starts after the length and command bytes
+    const uint8_t *data = frame + 2;
+    for (uint8_t i = 0; i < IBUS_CHANNELS && i < IBUS_FRAME_CHANNELS; i++) {
+        channel[i] = (data[i * 2] | (data[i * 2 + 1] << 8)) & 0x0FFF;
+    }
+#if IBUS_CHANNELS > IBUS_FRAME_CHANNELS
+    // extended channels, one nibble from each of three slots
+    for (uint8_t i = IBUS_FRAME_CHANNELS; i < IBUS_CHANNELS; i++) {
+        const uint8_t *high = data + (i - IBUS_FRAME_CHANNELS) * 6 + 1;
+        channel[i] = (high[0] >> 4) | (high[2] & 0xF0) | ((high[4] & 0xF0) << 4);
+    }
+#endif
+}
+
+uint8_t ibus_encode_channels(uint8_t *frame, const uint16_t *channel, uint8_t count) {
+    uint16_t chksum = 0xFFFF - IBUS_MAX_LENGTH - IBUS_COMMAND40;
+    frame[0] = IBUS_MAX_LENGTH;
+    frame[1] = IBUS_COMMAND40;
+    for (uint8_t i = 0; i < IBUS_FRAME_CHANNELS; i++) {
+        uint16_t value = (i < count ? channel[i] : IBUS_CHANNEL_CENTER) & 0x0FFF;
+        uint8_t extended = IBUS_FRAME_CHANNELS + i / 3;
+        if (extended < count) {
+            value |= ((channel[extended] >> (i % 3 * 4)) & 0x0F) << 12;
+        }
+        frame[2 + i * 2] = value & 0xFF;
+        frame[3 + i * 2] = value >> 8;
+        chksum -= frame[2 + i * 2] + frame[3 + i * 2];
+    }
+    frame[IBUS_MAX_LENGTH - 2] = chksum & 0xFF;
+    frame[IBUS_MAX_LENGTH - 1] = chksum >> 8;
+    return IBUS_MAX_LENGTH;
+}
@@ -0,0 +1,79 @@
+#ifndef IBUS_H
+#define IBUS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+  Portable iBUS protocol layer. Nothing in here touches the Pico SDK so the
+  same code runs in the RX interrupt on the RP2040 and in the host build.
+
+  A frame is kept exactly as it arrives on the wire:
+    [length] [command] [payload ...] [checksum low] [checksum high]
+  where length counts every byte of the frame, itself included.
+
+  A servo frame has 14 slots of 16 bits. The low 12 bits are the channel
+  value, receivers with 18 channels put channels 15 to 18 into the high
+  nibbles, three slots per channel, least significant nibble first.
+ */
+
+#define IBUS_MAX_LENGTH 0x20
+#define IBUS_OVERHEAD 0x03
+#define IBUS_COMMAND40 0x40
+#define IBUS_FRAME_CHANNELS 14
+#define IBUS_MAX_CHANNELS 18
+// number of channels decoded, anything past it is never touched
+#ifndef IBUS_CHANNELS
+#define IBUS_CHANNELS IBUS_FRAME_CHANNELS
+#endif
+#if IBUS_CHANNELS > IBUS_MAX_CHANNELS
+#error "iBUS carries at most 18 channels"
+#endif
+#define IBUS_CHANNEL_CENTER 1500
+
+// link errors seen by a parser or ring, only ever written by the receiver.
+// Once a frame is lost, the false headers rejected while looking for the
+// next one aren't counted again.
+typedef struct {
+    uint32_t chksum_errors; // frames dropped for a bad checksum
+    uint32_t resyncs;       // times the receiver lost track of frame boundaries
+    uint32_t overruns;      // times a ring consumer fell a lap behind
+} ibus_errors_t;
+
+typedef struct {
+    uint8_t buffer[IBUS_MAX_LENGTH]; // raw frame, length byte first
+    uint8_t ptr;                     // number of bytes received so far
+    uint8_t len;                     // length of the frame being received
+    uint16_t chksum;                 // running checksum (0xFFFF minus all bytes)
+    uint8_t skip;                    // bytes still to ignore, see ibus_parser_skip
+    bool synced;                     // frame in progress starts at a frame boundary
+    ibus_errors_t errors;
+} ibus_parser_t;
+
+// reset the parser so the next byte is treated as a frame header
+void ibus_parser_init(ibus_parser_t *parser);
+
+// consume a single byte, returns true once a frame with a valid checksum is
+// complete. The frame stays in parser->buffer until the next call.
+bool ibus_parser_feed(ibus_parser_t *parser, uint8_t value);
+
+// ignore the next count bytes, used on a half-duplex wire where everything
+// we transmit is received back
+static inline void ibus_parser_skip(ibus_parser_t *parser, uint8_t count) {
+    parser->skip += count;
+}
+
+// check if a byte can be the length byte of a frame
+static inline bool ibus_valid_length(uint8_t value) {
+    return value <= IBUS_MAX_LENGTH && value > IBUS_OVERHEAD;
+}
+
+// extract the first IBUS_CHANNELS channel values of a servo (0x40) frame
+void ibus_decode_channels(const uint8_t *frame, uint16_t *channel);
+
+// build a full size servo frame from count (up to 18) channel values, the
+// remaining slots are filled with the center position. Returns the frame
+// length.
+uint8_t ibus_encode_channels(uint8_t *frame, const uint16_t *channel, uint8_t count);
+
+#endif
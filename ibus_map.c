@@ -0,0 +1,51 @@
+#include "ibus_map.h"
+
+// shape of the curve at normalized deflection x in -1..1
+static float ibus_map_shape(const ibus_map_config_t *config, float x) {
+    float e = config->expo / 100.0f;
+    float y = (1.0f - e) * x + e * x * x * x;
+    y *= config->rate / 100.0f;
+    return config->reversed ? -y : y;
+}
+
+void ibus_map_configure(ibus_map_curve_t *curve, const ibus_map_config_t *config) {
+    uint16_t deadband = config->deadband;
+    // keep at least one live raw unit on either side
+    if (deadband >= config->center - config->min) deadband = config->center - config->min - 1;
+    if (deadband >= config->max - config->center) deadband = config->max - config->center - 1;
+    curve->origin[0] = config->min;
+    curve->origin[1] = config->center;
+    curve->max = config->max;
+    uint16_t range[2] = { config->center - config->min, config->max - config->center };
+    // the lower half rounds down so center - 1 stays below the center
+    // point, the upper half up so max lands on the last point
+    curve->scale[0] = (IBUS_MAP_SEGMENTS << 16) / range[0];
+    curve->scale[1] = ((IBUS_MAP_SEGMENTS << 16) + range[1] - 1) / range[1];
+    // points from the one below the lower deadband edge to the one above
+    // the upper edge are what the deadband values interpolate between
+    uint32_t dead_low = (range[0] - deadband) * curve->scale[0] >> 16;
+    uint32_t dead_high = ((IBUS_MAP_SEGMENTS << 16) + deadband * curve->scale[1] + 0xFFFF) >> 16;
+    for (uint32_t k = 0; k < IBUS_MAP_POINTS; k++) {
+        int side = k >= IBUS_MAP_SEGMENTS;
+        float x = ((float)k - IBUS_MAP_SEGMENTS) / IBUS_MAP_SEGMENTS;
+        float deflection = x < 0 ? -x : x;
+        float dead = (float)deadband / range[side];
+        float y = 0;
+        // the end points stay at full deflection even for a deadband
+        // reaching within a step of them
+        if (k < dead_low || k > dead_high || k == 0 || k == IBUS_MAP_POINTS - 1) {
+            float live = deflection > dead ? (deflection - dead) / (1.0f - dead) : 0;
+            y = ibus_map_shape(config, x < 0 ? -live : live) * IBUS_MAP_ONE;
+        }
+        if (y > IBUS_MAP_ONE) y = IBUS_MAP_ONE;
+        if (y < -IBUS_MAP_ONE) y = -IBUS_MAP_ONE;
+        curve->lut[k] = (int16_t)(y < 0 ? y - 0.5f : y + 0.5f);
+    }
+    curve->lut[IBUS_MAP_POINTS] = curve->lut[IBUS_MAP_POINTS - 1];
+}
+
+void ibus_map_channels(const ibus_map_curve_t *curves, const uint16_t *channel, int16_t *out) {
+    for (uint8_t i = 0; i < IBUS_CHANNELS; i++) {
+        out[i] = ibus_map_apply(&curves[i], channel[i]);
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef IBUS_MAP_H
+#define IBUS_MAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ibus.h"
+
+/*
+  Per-channel mapping from raw iBUS values to signed Q15 (-32767..32767).
+  Calibration, deadband, expo, rate and reversal are baked into a lookup
+  table when the channel is configured, mapping a value is then a clamp,
+  one multiply to a table index and a linear interpolation.
+
+  The two halves of the table span min to center and center to max, each
+  with its own scale, so the center is a table point whatever the two half
+  ranges are. The table points the deadband values fall between are 0, so
+  the whole deadband maps to 0 and the curve starts within one table step
+  of its edge.
+ */
+
+#define IBUS_MAP_SEGMENTS 128                      // per half of the range
+#define IBUS_MAP_POINTS (IBUS_MAP_SEGMENTS * 2 + 1)
+#define IBUS_MAP_ONE 32767
+
+// calibration needs min < center < max
+typedef struct {
+    uint16_t min;      // calibrated raw value at full low
+    uint16_t center;   // calibrated raw value at rest
+    uint16_t max;      // calibrated raw value at full high
+    uint16_t deadband; // raw units either side of center that map to 0
+    uint8_t expo;      // 0 linear .. 100 fully cubic
+    uint8_t rate;      // output at full deflection, percent
+    bool reversed;
+} ibus_map_config_t;
+
+#define IBUS_MAP_DEFAULT { 1000, 1500, 2000, 0, 0, 100, false }
+
+typedef struct {
+    uint16_t origin[2]; // min and center, where the two halves start
+    uint16_t max;
+    uint32_t scale[2];  // Q16 segments per raw unit below and above center
+    int16_t lut[IBUS_MAP_POINTS + 1]; // last point repeated for the interpolation
+} ibus_map_curve_t;
+
+// build the lookup table of a channel, only needed when the config changes
+void ibus_map_configure(ibus_map_curve_t *curve, const ibus_map_config_t *config);
+
+static inline int16_t ibus_map_apply(const ibus_map_curve_t *curve, uint16_t value) {
+    if (value < curve->origin[0]) value = curve->origin[0];
+    if (value > curve->max) value = curve->max;
+    uint32_t side = value >= curve->origin[1];
+    uint32_t pos = (side * IBUS_MAP_SEGMENTS << 16) + (value - curve->origin[side]) * curve->scale[side];
+    // the scales round up, so max can land just past the last point
+    uint32_t i = pos >> 16;
+    int32_t frac = (pos & 0xFFFF) >> 1; // Q15 so the product fits 32 bits
+    int32_t low = curve->lut[i];
+    return low + (((curve->lut[i + 1] - low) * frac) >> 15);
+}
+
+// map the IBUS_CHANNELS values of a frame with one curve per channel
+void ibus_map_channels(const ibus_map_curve_t *curves, const uint16_t *channel, int16_t *out);
+
+#endif
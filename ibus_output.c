@@ -0,0 +1,37 @@
+#include "ibus_output.h"
+
+static void ibus_output_failsafe(ibus_output_t *output) {
+    for (uint8_t i = 0; i < output->count; i++) {
+        output->backend->write(output->backend->ctx, i, output->config[i].failsafe_us);
+    }
+    output->failsafe = true;
+}
+
+void ibus_output_init(ibus_output_t *output, const ibus_output_backend_t *backend,
+                      const ibus_output_config_t *config, uint8_t count, uint32_t timeout_us) {
+    output->backend = backend;
+    output->config = config;
+    output->count = count;
+    output->timeout_us = timeout_us;
+    output->last_frame_us = 0;
+    output->failsafes = 0;
+    ibus_output_failsafe(output);
+}
+
+void ibus_output_frame(ibus_output_t *output, const int16_t *mapped, uint32_t now_us) {
+    for (uint8_t i = 0; i < output->count; i++) {
+        const ibus_output_config_t *config = &output->config[i];
+        int32_t pulse = config->center_us + ((mapped[config->channel] * config->range_us) >> 15);
+        output->backend->write(output->backend->ctx, i, pulse);
+    }
+    output->last_frame_us = now_us;
+    output->failsafe = false;
+}
+
+bool ibus_output_check(ibus_output_t *output, uint32_t now_us) {
+    if (!output->failsafe && now_us - output->last_frame_us > output->timeout_us) {
+        ibus_output_failsafe(output);
+        output->failsafes++;
+    }
+    return output->failsafe;
+}
@@ -0,0 +1,52 @@
+#ifndef IBUS_OUTPUT_H
+#define IBUS_OUTPUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ibus.h"
+
+/*
+  Servo/ESC output stage. Every valid frame goes straight to the outputs
+  from the decoder, and a periodic check drives them to their failsafe
+  pulse once no frame has arrived for timeout_us. The hardware sits behind
+  a backend so the same path runs against PWM slices on the RP2040 and a
+  fake in the host build.
+
+  ibus_output_frame() and ibus_output_check() must not preempt each other,
+  run them from interrupts of the same priority on the same core.
+ */
+
+typedef struct {
+    // set the pulse width of one output, in microseconds
+    void (*write)(void *ctx, uint8_t output, uint16_t pulse_us);
+    void *ctx;
+} ibus_output_backend_t;
+
+typedef struct {
+    uint8_t channel;      // source channel
+    uint16_t center_us;   // pulse for a mapped value of 0
+    uint16_t range_us;    // pulse change at full deflection
+    uint16_t failsafe_us; // pulse while the link is lost
+} ibus_output_config_t;
+
+typedef struct {
+    const ibus_output_backend_t *backend;
+    const ibus_output_config_t *config;
+    uint8_t count;
+    uint32_t timeout_us;
+    uint32_t last_frame_us; // receive time of the last frame
+    bool failsafe;          // outputs are at their failsafe pulse
+    uint32_t failsafes;     // number of times failsafe engaged
+} ibus_output_t;
+
+// set up the outputs, they start in failsafe until the first frame
+void ibus_output_init(ibus_output_t *output, const ibus_output_backend_t *backend,
+                      const ibus_output_config_t *config, uint8_t count, uint32_t timeout_us);
+
+// drive the outputs from the mapped (Q15) channels of a valid frame
+void ibus_output_frame(ibus_output_t *output, const int16_t *mapped, uint32_t now_us);
+
+// engage failsafe if the last frame is too old, returns true while in failsafe
+bool ibus_output_check(ibus_output_t *output, uint32_t now_us);
+
+#endif
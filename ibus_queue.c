@@ -0,0 +1,31 @@
+#include "ibus_queue.h"
+
+void ibus_queue_init(ibus_queue_t *queue) {
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    atomic_init(&queue->dropped, 0);
+}
+
+bool ibus_queue_push(ibus_queue_t *queue, const ibus_frame_snapshot_t *frame) {
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    if (head - tail >= IBUS_QUEUE_SIZE) {
+        // only the producer writes dropped, a plain store avoids needing an
+        // atomic add on the M0+
+        uint32_t dropped = atomic_load_explicit(&queue->dropped, memory_order_relaxed);
+        atomic_store_explicit(&queue->dropped, dropped + 1, memory_order_relaxed);
+        return false;
+    }
+    queue->slots[head & (IBUS_QUEUE_SIZE - 1)] = *frame;
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return true;
+}
+
+bool ibus_queue_pop(ibus_queue_t *queue, ibus_frame_snapshot_t *frame) {
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    if (head == tail) return false;
+    *frame = queue->slots[tail & (IBUS_QUEUE_SIZE - 1)];
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    return true;
+}
@@ -0,0 +1,33 @@
+#ifndef IBUS_QUEUE_H
+#define IBUS_QUEUE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "ibus_snapshot.h"
+
+/*
+  Single producer, single consumer queue of decoded frames, used to hand
+  frames from the core doing the receiving to the core running the
+  application. Neither side ever waits: a full queue drops the new frame and
+  counts it, so a consumer held up by a slow USB host can't stall decoding.
+ */
+
+#define IBUS_QUEUE_SIZE 16 // must be a power of two
+
+typedef struct {
+    atomic_uint head;    // next slot to write, only moved by the producer
+    atomic_uint tail;    // next slot to read, only moved by the consumer
+    atomic_uint dropped; // frames lost because the queue was full
+    ibus_frame_snapshot_t slots[IBUS_QUEUE_SIZE];
+} ibus_queue_t;
+
+void ibus_queue_init(ibus_queue_t *queue);
+
+// producer side, returns false if the frame was dropped
+bool ibus_queue_push(ibus_queue_t *queue, const ibus_frame_snapshot_t *frame);
+
+// consumer side, returns false if the queue is empty
+bool ibus_queue_pop(ibus_queue_t *queue, ibus_frame_snapshot_t *frame);
+
+#endif
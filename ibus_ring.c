@@ -0,0 +1,81 @@
+#include <stdatomic.h>
+#include "ibus_ring.h"
+
+void ibus_ring_init(ibus_ring_t *ring, const uint8_t *data, uint32_t size) {
+    ring->data = data;
+    ring->mask = size - 1;
+    ring->tail = 0;
+    ring->synced = true;
+    ring->broken = 0;
+    ring->errors.chksum_errors = 0;
+    ring->errors.resyncs = 0;
+    ring->errors.overruns = 0;
+}
+
+bool ibus_ring_next(ibus_ring_t *ring, uint32_t written, const uint8_t **frame) {
+    const uint8_t *data = ring->data;
+    uint32_t mask = ring->mask;
+    // bytes before written must be visible before we look at them
+    atomic_thread_fence(memory_order_acquire);
+    if (written - ring->tail > mask + 1) {
+        // the producer lapped us and overwrote bytes we hadn't read, carry
+        // on from the write position with whatever comes next
+        ring->tail = written;
+        ring->synced = false;
+        ring->broken = 0;
+        ring->errors.overruns++;
+        return false;
+    }
+    while (true) {
+        uint32_t tail = ring->tail;
+        uint32_t avail = written - tail;
+        if (avail == 0) return false;
+        uint8_t fb = data[tail & mask];
+        // like the parser, a frame lying wholly inside a broken one is
+        // taken for a fragment of it
+        if (!ibus_valid_length(fb) || fb <= ring->broken) {
+            ring->tail = tail + 1; // line noise or a fragment
+            if (ring->broken) ring->broken--;
+            continue;
+        }
+        if (avail < 2) return false;
+        if (fb == IBUS_MAX_LENGTH && data[(tail + 1) & mask] != IBUS_COMMAND40) {
+            ring->tail = tail + 1; // 0x20 not followed by 0x40
+            if (ring->broken) ring->broken--;
+            if (ring->synced) ring->errors.resyncs++;
+            ring->synced = false;
+            continue;
+        }
+        if (avail < fb) return false; // rest of the frame is still in flight
+        uint16_t chksum = 0xFFFF;
+        for (uint32_t i = 0; i < fb - 2u; i++) {
+            chksum -= data[(tail + i) & mask];
+        }
+        uint16_t rx = data[(tail + fb - 2) & mask] | (data[(tail + fb - 1) & mask] << 8);
+        if (chksum != rx) {
+            // skip just the length byte so a header inside is still found
+            ring->tail = tail + 1;
+            ring->broken = fb - 1;
+            if (ring->synced) {
+                ring->errors.chksum_errors++;
+                ring->errors.resyncs++;
+            }
+            ring->synced = false;
+            continue;
+        }
+        uint32_t start = tail & mask;
+        if (start + fb <= mask + 1) {
+            *frame = data + start;
+        } else {
+            // frame wraps around the end of the ring, linearize it
+            for (uint32_t i = 0; i < fb; i++) {
+                ring->scratch[i] = data[(tail + i) & mask];
+            }
+            *frame = ring->scratch;
+        }
+        ring->tail = tail + fb;
+        ring->synced = true;
+        ring->broken = 0;
+        return true;
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef IBUS_RING_H
+#define IBUS_RING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ibus.h"
+
+/*
+  Frame extraction straight out of a circular receive buffer. The producer
+  (a DMA channel on the RP2040, a thread in the host build) writes bytes into
+  the ring and reports how many it has written in total, the consumer hands
+  out frames in place without copying them anywhere first. Both counts run
+  freely and wrap at 2^32, the ring position is the count modulo the size,
+  so a consumer that fell a whole lap behind is noticed.
+ */
+
+typedef struct {
+    const uint8_t *data;              // ring storage, filled by the producer
+    uint32_t mask;                    // size - 1, size must be a power of two
+    uint32_t tail;                    // bytes consumed so far
+    uint8_t scratch[IBUS_MAX_LENGTH]; // copy of a frame that wraps around
+    bool synced;                      // tail is at a frame boundary
+    uint8_t broken;                   // bytes left of the last frame that failed its checksum
+    ibus_errors_t errors;
+} ibus_ring_t;
+
+void ibus_ring_init(ibus_ring_t *ring, const uint8_t *data, uint32_t size);
+
+// find the next valid frame in the bytes up to written, the producer's byte
+// count. On success frame points at the raw frame, which stays valid until
+// the producer has written another size bytes. If more than size bytes went
+// unread they are skipped and counted as an overrun.
+bool ibus_ring_next(ibus_ring_t *ring, uint32_t written, const uint8_t **frame);
+
+#endif
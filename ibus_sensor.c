@@ -0,0 +1,52 @@
+#include "ibus_sensor.h"
+
+typedef uint8_t (*ibus_sensor_handler_t)(const ibus_sensor_t *sensor, uint8_t *reply);
+
+static uint8_t ibus_sensor_discover(const ibus_sensor_t *sensor, uint8_t *reply) {
+    (void)sensor;
+    (void)reply;
+    return 4; // the request itself is the answer
+}
+
+static uint8_t ibus_sensor_type(const ibus_sensor_t *sensor, uint8_t *reply) {
+    reply[2] = sensor->type;
+    reply[3] = sensor->size;
+    return 6;
+}
+
+static uint8_t ibus_sensor_measure(const ibus_sensor_t *sensor, uint8_t *reply) {
+    int32_t value = sensor->value;
+    for (uint8_t i = 0; i < sensor->size; i++) {
+        reply[2 + i] = value >> (i * 8);
+    }
+    return 4 + sensor->size;
+}
+
+// indexed by the high nibble of the command byte, starting at 0x8n
+static const ibus_sensor_handler_t handlers[] = {
+    ibus_sensor_discover,
+    ibus_sensor_type,
+    ibus_sensor_measure,
+};
+
+uint8_t ibus_sensor_respond(ibus_sensor_t *sensors, uint8_t count, const uint8_t *frame,
+                            uint32_t age_us, uint8_t *reply) {
+    uint8_t command = frame[1];
+    uint8_t address = command & 0x0F;
+    uint8_t kind = (command >> 4) - (IBUS_COMMAND_DISCOVER >> 4);
+    // requests are always 4 bytes, anything else isn't meant for a sensor
+    if (frame[0] != 4 || command < IBUS_COMMAND_DISCOVER) return 0;
+    if (kind >= sizeof(handlers) / sizeof(handlers[0])) return 0;
+    if (address == 0 || address > count) return 0;
+    if (age_us > IBUS_SENSOR_WINDOW_US) return 0;
+    reply[1] = command;
+    uint8_t len = handlers[kind](&sensors[address - 1], reply);
+    reply[0] = len;
+    uint16_t chksum = 0xFFFF;
+    for (uint8_t i = 0; i < len - 2; i++) {
+        chksum -= reply[i];
+    }
+    reply[len - 2] = chksum & 0xFF;
+    reply[len - 1] = chksum >> 8;
+    return len;
+}
@@ -0,0 +1,40 @@
+#ifndef IBUS_SENSOR_H
+#define IBUS_SENSOR_H
+
+#include <stdint.h>
+#include "ibus.h"
+
+/*
+  iBUS telemetry. The receiver polls each sensor address with a 4 byte
+  frame and the sensor answers on the same wire:
+    0x8n discover     -> echo of the request
+    0x9n type         -> [06] [9n] [type] [size] [checksum]
+    0xAn measurement  -> [04 + size] [An] [value, little endian] [checksum]
+  Address n = 1 is the first entry of the sensor table. A reply that starts
+  too late collides with the receiver's next transmission, so requests older
+  than IBUS_SENSOR_WINDOW_US are left unanswered.
+ */
+
+#define IBUS_COMMAND_DISCOVER 0x80
+#define IBUS_COMMAND_TYPE 0x90
+#define IBUS_COMMAND_MEASURE 0xA0
+
+#define IBUS_SENSOR_TEMPERATURE 0x01 // 0.1 degrees C, offset by 400
+#define IBUS_SENSOR_RPM 0x02
+#define IBUS_SENSOR_EXTV 0x03        // 0.01 V
+
+#define IBUS_SENSOR_WINDOW_US 1000
+#define IBUS_SENSOR_REPLY_MAX 8
+
+typedef struct {
+    uint8_t type;           // one of the IBUS_SENSOR_* codes
+    uint8_t size;           // measurement size in bytes, 2 or 4
+    volatile int32_t value; // latest measurement, updated by the application
+} ibus_sensor_t;
+
+// build the reply to a sensor request. age_us is the time since the request
+// was received. Returns the reply length, 0 if nothing should be sent.
+uint8_t ibus_sensor_respond(ibus_sensor_t *sensors, uint8_t count, const uint8_t *frame,
+                            uint32_t age_us, uint8_t *reply);
+
+#endif
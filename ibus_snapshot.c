@@ -0,0 +1,44 @@
+#include "ibus_snapshot.h"
+
+void ibus_snapshot_init(ibus_snapshot_t *snapshot) {
+    atomic_init(&snapshot->seq, 0);
+    atomic_init(&snapshot->timestamp, 0);
+    for (uint8_t i = 0; i < IBUS_SNAPSHOT_WORDS; i++) {
+        atomic_init(&snapshot->words[i], 0);
+    }
+}
+
+void ibus_snapshot_publish(ibus_snapshot_t *snapshot, const uint16_t *channel, uint32_t timestamp) {
+    uint32_t seq = atomic_load_explicit(&snapshot->seq, memory_order_relaxed);
+    // mark the write as in progress before touching the data
+    atomic_store_explicit(&snapshot->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&snapshot->timestamp, timestamp, memory_order_relaxed);
+    for (uint8_t i = 0; i < IBUS_CHANNELS / 2; i++) {
+        uint32_t word = channel[i * 2] | ((uint32_t)channel[i * 2 + 1] << 16);
+        atomic_store_explicit(&snapshot->words[i], word, memory_order_relaxed);
+    }
+#if IBUS_CHANNELS % 2
+    atomic_store_explicit(&snapshot->words[IBUS_SNAPSHOT_WORDS - 1], channel[IBUS_CHANNELS - 1], memory_order_relaxed);
+#endif
+    atomic_store_explicit(&snapshot->seq, seq + 2, memory_order_release);
+}
+
+bool ibus_snapshot_read(ibus_snapshot_t *snapshot, ibus_frame_snapshot_t *out) {
+    uint32_t words[IBUS_SNAPSHOT_WORDS];
+    uint32_t seq;
+    do {
+        seq = atomic_load_explicit(&snapshot->seq, memory_order_acquire);
+        if (seq & 1) continue; // writer is busy
+        out->timestamp = atomic_load_explicit(&snapshot->timestamp, memory_order_relaxed);
+        for (uint8_t i = 0; i < IBUS_SNAPSHOT_WORDS; i++) {
+            words[i] = atomic_load_explicit(&snapshot->words[i], memory_order_relaxed);
+        }
+        atomic_thread_fence(memory_order_acquire);
+    } while ((seq & 1) || seq != atomic_load_explicit(&snapshot->seq, memory_order_relaxed));
+    for (uint8_t i = 0; i < IBUS_CHANNELS; i++) {
+        out->channel[i] = words[i / 2] >> ((i & 1) * 16);
+    }
+    out->frame = seq / 2;
+    return seq != 0;
+}
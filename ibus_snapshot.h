@@ -0,0 +1,42 @@
+#ifndef IBUS_SNAPSHOT_H
+#define IBUS_SNAPSHOT_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "ibus.h"
+
+/*
+  Latest decoded frame, published by the receive path and readable from the
+  main loop or the other core without disabling interrupts. Backed by a
+  seqlock: the writer never waits, a reader retries if a publish happened
+  while it was copying. The data is kept in 32-bit words accessed through
+  relaxed atomics, which compile to plain loads and stores on the M0+.
+
+  Don't read from an interrupt that can preempt the publisher on the same
+  core, the reader would spin forever on the half written frame.
+ */
+
+#define IBUS_SNAPSHOT_WORDS ((IBUS_CHANNELS + 1) / 2)
+
+typedef struct {
+    uint32_t frame;                   // frame counter, starts at 1
+    uint32_t timestamp;               // receive time in microseconds
+    uint16_t channel[IBUS_CHANNELS];
+} ibus_frame_snapshot_t;
+
+typedef struct {
+    atomic_uint seq;                  // odd while a publish is in progress
+    atomic_uint timestamp;
+    atomic_uint words[IBUS_SNAPSHOT_WORDS]; // two channels per word
+} ibus_snapshot_t;
+
+void ibus_snapshot_init(ibus_snapshot_t *snapshot);
+
+// publish a new frame, only ever call this from a single writer
+void ibus_snapshot_publish(ibus_snapshot_t *snapshot, const uint16_t *channel, uint32_t timestamp);
+
+// copy the latest frame, returns false if nothing was published yet
+bool ibus_snapshot_read(ibus_snapshot_t *snapshot, ibus_frame_snapshot_t *out);
+
+#endif
@@ -0,0 +1,44 @@
+#include <string.h>
+#include "ibus_stats.h"
+
+void ibus_stats_init(ibus_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+void ibus_stats_report_init(ibus_stats_report_t *report, uint32_t now_us) {
+    memset(report, 0, sizeof(*report));
+    report->time_us = now_us;
+}
+
+// difference to the previous record, saturated to fit the record
+static uint16_t ibus_stats_delta(uint32_t value, uint32_t *previous) {
+    uint32_t delta = value - *previous;
+    *previous = value;
+    return delta > 0xFFFF ? 0xFFFF : delta;
+}
+
+void ibus_stats_record(ibus_stats_report_t *report, const ibus_stats_t *stats,
+                       const ibus_errors_t *errors, const ibus_stats_losses_t *losses,
+                       uint32_t now_us, ibus_stats_record_t *record) {
+    // the receive path keeps running while we read, each field on its own
+    // is consistent, which is all a statistic needs
+    uint32_t frames = stats->frames;
+    uint32_t elapsed = now_us - report->time_us;
+    record->version = IBUS_STATS_VERSION;
+    record->buckets = IBUS_STATS_BUCKETS;
+    record->frame_rate = elapsed ? (uint64_t)(frames - report->frames) * 1000000 / elapsed : 0;
+    record->frames = frames;
+    record->chksum_errors = errors->chksum_errors;
+    record->resyncs = errors->resyncs;
+    record->overruns = stats->overruns + errors->overruns;
+    record->queue_drops = losses->queue_drops;
+    record->failsafes = losses->failsafes;
+    record->stream_drops = losses->stream_drops;
+    record->rx_max_us = stats->rx_max_us > 0xFFFF ? 0xFFFF : stats->rx_max_us;
+    for (uint8_t i = 0; i < IBUS_STATS_BUCKETS; i++) {
+        record->gap_hist[i] = ibus_stats_delta(stats->gap_hist[i], &report->gap_hist[i]);
+        record->rx_hist[i] = ibus_stats_delta(stats->rx_hist[i], &report->rx_hist[i]);
+    }
+    report->frames = frames;
+    report->time_us = now_us;
+}
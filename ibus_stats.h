@@ -0,0 +1,86 @@
+#ifndef IBUS_STATS_H
+#define IBUS_STATS_H
+
+#include <stdint.h>
+#include "ibus.h"
+
+/*
+  Link quality counters. ibus_stats_t is only ever written by the receive
+  path, the main loop turns it into a compact binary record. Histograms use
+  log2 buckets: bucket 0 counts 0 us, bucket n counts 2^(n-1) .. 2^n - 1 us
+  and the last bucket everything above.
+ */
+
+#define IBUS_STATS_VERSION 3
+#define IBUS_STATS_BUCKETS 16
+
+typedef struct {
+    uint32_t frames;        // valid servo frames
+    uint32_t overruns;      // UART receive FIFO overruns
+    uint32_t last_frame_us; // receive time of the last frame
+    uint32_t rx_max_us;     // longest run of the receive handler
+    uint32_t gap_hist[IBUS_STATS_BUCKETS]; // time between valid frames
+    uint32_t rx_hist[IBUS_STATS_BUCKETS];  // time spent in the receive handler
+} ibus_stats_t;
+
+// frames and records lost after decoding and failsafe events, counted
+// outside the receive path and passed in when a record is built
+typedef struct {
+    uint32_t queue_drops;  // frames dropped by a full handoff queue
+    uint32_t failsafes;    // times the outputs went to failsafe
+    uint32_t stream_drops; // records not sent because the host wasn't reading
+} ibus_stats_losses_t;
+
+// state of whoever builds the records, histograms are reported per record
+typedef struct {
+    uint32_t frames;
+    uint32_t time_us;
+    uint32_t gap_hist[IBUS_STATS_BUCKETS];
+    uint32_t rx_hist[IBUS_STATS_BUCKETS];
+} ibus_stats_report_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t version;       // IBUS_STATS_VERSION
+    uint8_t buckets;       // IBUS_STATS_BUCKETS
+    uint16_t frame_rate;   // valid frames per second since the last record
+    uint32_t frames;       // the counters are totals since boot
+    uint32_t chksum_errors;
+    uint32_t resyncs;
+    uint32_t overruns;     // UART FIFO overruns plus ring laps
+    uint32_t queue_drops;
+    uint32_t failsafes;
+    uint32_t stream_drops;
+    uint16_t rx_max_us;
+    uint16_t gap_hist[IBUS_STATS_BUCKETS]; // the histograms only count
+    uint16_t rx_hist[IBUS_STATS_BUCKETS];  // since the last record
+} ibus_stats_record_t;
+
+void ibus_stats_init(ibus_stats_t *stats);
+
+static inline uint8_t ibus_stats_bucket(uint32_t us) {
+    uint8_t bucket = us ? 32 - __builtin_clz(us) : 0;
+    return bucket < IBUS_STATS_BUCKETS ? bucket : IBUS_STATS_BUCKETS - 1;
+}
+
+// a valid frame was received at now_us
+static inline void ibus_stats_frame(ibus_stats_t *stats, uint32_t now_us) {
+    if (stats->frames++) {
+        stats->gap_hist[ibus_stats_bucket(now_us - stats->last_frame_us)]++;
+    }
+    stats->last_frame_us = now_us;
+}
+
+// the receive handler ran for us microseconds
+static inline void ibus_stats_rx_time(ibus_stats_t *stats, uint32_t us) {
+    stats->rx_hist[ibus_stats_bucket(us)]++;
+    if (us > stats->rx_max_us) stats->rx_max_us = us;
+}
+
+void ibus_stats_report_init(ibus_stats_report_t *report, uint32_t now_us);
+
+// build a record from the receiver's stats, error counters and losses
+void ibus_stats_record(ibus_stats_report_t *report, const ibus_stats_t *stats,
+                       const ibus_errors_t *errors, const ibus_stats_losses_t *losses,
+                       uint32_t now_us, ibus_stats_record_t *record);
+
+#endif
@@ -0,0 +1,102 @@
+#include <string.h>
+#include "ibus_stream.h"
+
+// CRC-16/CCITT a nibble at a time, small enough to keep the table in flash
+static const uint16_t crc_table[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+
+static uint16_t ibus_stream_crc(const uint8_t *data, uint8_t len) {
+    uint16_t crc = 0xFFFF;
+    for (uint8_t i = 0; i < len; i++) {
+        crc = (crc << 4) ^ crc_table[(crc >> 12) ^ (data[i] >> 4)];
+        crc = (crc << 4) ^ crc_table[(crc >> 12) ^ (data[i] & 0x0F)];
+    }
+    return crc;
+}
+
+uint8_t ibus_stream_seal(uint8_t *out, uint8_t type, uint8_t len) {
+    out[0] = IBUS_STREAM_SYNC0;
+    out[1] = IBUS_STREAM_SYNC1;
+    out[2] = type;
+    out[3] = len;
+    uint16_t crc = ibus_stream_crc(out + 2, len + 2);
+    out[IBUS_STREAM_HEADER + len] = crc & 0xFF;
+    out[IBUS_STREAM_HEADER + len + 1] = crc >> 8;
+    return IBUS_STREAM_HEADER + len + IBUS_STREAM_TRAILER;
+}
+
+uint8_t ibus_stream_frame(uint8_t *out, const ibus_frame_snapshot_t *frame) {
+    uint8_t *p = out + IBUS_STREAM_HEADER;
+    p[0] = frame->frame & 0xFF;
+    p[1] = frame->frame >> 8;
+    p[2] = frame->timestamp & 0xFF;
+    p[3] = frame->timestamp >> 8;
+    p[4] = frame->timestamp >> 16;
+    p[5] = frame->timestamp >> 24;
+    p[6] = IBUS_CHANNELS;
+    p += 7;
+    for (uint8_t i = 0; i < IBUS_CHANNELS; i += 2) {
+        uint16_t a = frame->channel[i] & 0x0FFF;
+        uint16_t b = i + 1 < IBUS_CHANNELS ? frame->channel[i + 1] & 0x0FFF : 0;
+        *p++ = a & 0xFF;
+        *p++ = (a >> 8) | (b << 4);
+        if (i + 1 < IBUS_CHANNELS) *p++ = b >> 4;
+    }
+    return ibus_stream_seal(out, IBUS_STREAM_FRAME, p - out - IBUS_STREAM_HEADER);
+}
+
+uint8_t ibus_stream_unpack_frame(const uint8_t *record, ibus_frame_snapshot_t *frame) {
+    const uint8_t *p = record + IBUS_STREAM_HEADER;
+    uint8_t count = p[6];
+    frame->frame = p[0] | (p[1] << 8);
+    frame->timestamp = p[2] | (p[3] << 8) | ((uint32_t)p[4] << 16) | ((uint32_t)p[5] << 24);
+    p += 7;
+    for (uint8_t i = 0; i < count && i < IBUS_CHANNELS; i++) {
+        const uint8_t *pair = p + i / 2 * 3;
+        frame->channel[i] = i & 1 ? (pair[1] >> 4) | (pair[2] << 4) : pair[0] | ((pair[1] & 0x0F) << 8);
+    }
+    return count;
+}
+
+void ibus_stream_parser_init(ibus_stream_parser_t *parser) {
+    parser->ptr = 0;
+    parser->consumed = 0;
+    parser->crc_errors = 0;
+}
+
+static void ibus_stream_parser_drop(ibus_stream_parser_t *parser, uint8_t count) {
+    parser->ptr -= count;
+    memmove(parser->buffer, parser->buffer + count, parser->ptr);
+}
+
+bool ibus_stream_parser_feed(ibus_stream_parser_t *parser, uint8_t value) {
+    if (parser->consumed) {
+        ibus_stream_parser_drop(parser, parser->consumed);
+        parser->consumed = 0;
+    }
+    parser->buffer[parser->ptr++] = value;
+    // anything that turns out not to be a record only costs its first byte,
+    // so a sync marker inside a broken record is still found
+    while (parser->ptr) {
+        uint8_t *b = parser->buffer;
+        if (b[0] != IBUS_STREAM_SYNC0 || (parser->ptr > 1 && b[1] != IBUS_STREAM_SYNC1) ||
+            (parser->ptr > 3 && b[3] > IBUS_STREAM_MAX_PAYLOAD)) {
+            ibus_stream_parser_drop(parser, 1);
+            continue;
+        }
+        if (parser->ptr < IBUS_STREAM_HEADER) return false;
+        uint8_t len = b[3];
+        uint8_t need = IBUS_STREAM_HEADER + len + IBUS_STREAM_TRAILER;
+        if (parser->ptr < need) return false;
+        uint16_t rx = b[IBUS_STREAM_HEADER + len] | (b[IBUS_STREAM_HEADER + len + 1] << 8);
+        if (ibus_stream_crc(b + 2, len + 2) == rx) {
+            parser->consumed = need;
+            return true;
+        }
+        parser->crc_errors++;
+        ibus_stream_parser_drop(parser, 1);
+    }
+    return false;
+}
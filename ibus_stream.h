@@ -0,0 +1,55 @@
+#ifndef IBUS_STREAM_H
+#define IBUS_STREAM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ibus.h"
+#include "ibus_snapshot.h"
+
+/*
+  Binary record stream sent over USB serial, and read back by the host
+  tools. Every record is
+    [A5] [5A] [type] [payload length] [payload ...] [crc low] [crc high]
+  with a CRC-16/CCITT (0x1021, start 0xFFFF) over type, length and payload.
+
+  A frame record carries the 16 bit sequence number of the frame, the
+  receive timestamp in microseconds, the channel count and the channels
+  packed into 12 bits each, two channels to three bytes. All values are
+  little endian.
+ */
+
+#define IBUS_STREAM_SYNC0 0xA5
+#define IBUS_STREAM_SYNC1 0x5A
+#define IBUS_STREAM_FRAME 0x01
+#define IBUS_STREAM_STATS 0x02
+
+#define IBUS_STREAM_HEADER 4
+#define IBUS_STREAM_TRAILER 2
+#define IBUS_STREAM_MAX_PAYLOAD 112
+#define IBUS_STREAM_MAX (IBUS_STREAM_HEADER + IBUS_STREAM_MAX_PAYLOAD + IBUS_STREAM_TRAILER)
+
+// payload of a record is written to out + IBUS_STREAM_HEADER, this adds the
+// header and the CRC around it. Returns the record length.
+uint8_t ibus_stream_seal(uint8_t *out, uint8_t type, uint8_t len);
+
+// build a frame record in out, returns the record length
+uint8_t ibus_stream_frame(uint8_t *out, const ibus_frame_snapshot_t *frame);
+
+// unpack a frame record. frame->frame holds the sequence number, returns the
+// channel count of the record (channels past IBUS_CHANNELS are dropped).
+uint8_t ibus_stream_unpack_frame(const uint8_t *record, ibus_frame_snapshot_t *frame);
+
+typedef struct {
+    uint8_t buffer[IBUS_STREAM_MAX];
+    uint8_t ptr;        // bytes in the buffer
+    uint8_t consumed;   // length of the record handed out by the last call
+    uint32_t crc_errors;
+} ibus_stream_parser_t;
+
+void ibus_stream_parser_init(ibus_stream_parser_t *parser);
+
+// consume one byte, returns true once a record with a valid CRC is complete
+// at the start of parser->buffer. It stays there until the next call.
+bool ibus_stream_parser_feed(ibus_stream_parser_t *parser, uint8_t value);
+
+#endif
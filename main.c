@@ -1,7 +1,22 @@
-#include <stdio.h>
 #include "pico/stdlib.h"
 #include "hardware/uart.h"
 #include "hardware/irq.h"
+#include "hardware/dma.h"
+#include "hardware/sync.h"
+#include "hardware/adc.h"
+#include "hardware/pwm.h"
+#include "hardware/clocks.h"
+#include "pico/multicore.h"
+#include "ibus.h"
+#include "ibus_ring.h"
+#include "ibus_snapshot.h"
+#include "ibus_queue.h"
+#include "ibus_sensor.h"
+#include "ibus_map.h"
+#include "ibus_output.h"
+#include "ibus_stats.h"
+#include "ibus_stream.h"
+#include "tusb.h"
 
 /*
   Example set of bytes coming over the iBUS line for setting servos: 
@@ -31,59 +46,245 @@
 #define DATA_BITS 8
 #define STOP_BITS 1
 #define PARITY UART_PARITY_NONE
-#define PROTOCOL_LENGTH 0x20
-#define PROTOCOL_OVERHEAD 0x03
-#define PROTOCOL_COMMAND40 0x40
-#define PROTOCOL_CHANNELS 6
+#define UART_TX_PIN 4
 #define UART_RX_PIN 5
+// receive FIFO depth, one byte and the RX timeout in microseconds (8N1)
+#define RX_FIFO_DEPTH 32
+#define RX_BYTE_US (10 * 1000000 / BAUD_RATE)
+#define RX_TIMEOUT_US (32 * 1000000 / BAUD_RATE)
 #define RED_PIN 18
+// receive through DMA into a ring buffer instead of the RX interrupt
+#ifndef IBUS_RX_DMA
+#define IBUS_RX_DMA 0
+#endif
+#define RX_RING_BITS 8
+// a frame can sit this long in the ring before the timer finds it and the
+// outputs move, the UART receive timeout can't cut it short because the
+// DMA keeps the FIFO empty. Core 1 ingest polls nonstop and doesn't wait.
+#define RX_POLL_US 2000
+// run reception and decoding on core 1, core 0 only gets decoded frames
+#ifndef IBUS_CORE1_INGEST
+#define IBUS_CORE1_INGEST 0
+#endif
+// answer sensor polls, TX and RX share the iBUS wire through a diode
+#ifndef IBUS_TELEMETRY
+#define IBUS_TELEMETRY 0
+#endif
+#if IBUS_TELEMETRY && IBUS_RX_DMA
+#error "telemetry needs the interrupt receive path to answer in time"
+#endif
+#define TEMP_ADC_INPUT 4
+#define STICK_CHANNELS 4
+#define STICK_DEADBAND 8
+// servo outputs, 50 Hz frame with a 1 MHz PWM counter so levels are in us
+#define SERVO_PWM_HZ 1000000
+#define SERVO_PWM_WRAP 20000
+#define FAILSAFE_TIMEOUT_US 100000
+#define FAILSAFE_CHECK_US 10000
+#define FAILSAFE_ALARM 2
+// status LED and stats record periods
+#define LED_PERIOD_US 250000
+#define STATS_PERIOD_US 500000
+// retry delays after the host stopped reading the USB stream
+#define STREAM_BACKOFF_MIN_US 1000
+#define STREAM_BACKOFF_MAX_US 100000
 
-uint8_t buffer[32];
-uint8_t ptr = 0;
-uint8_t len = 0;
-uint16_t chksum = 0;
-uint16_t lchksum = 0;
-uint16_t hchksum = 0;
-uint16_t channel[PROTOCOL_CHANNELS];
+ibus_parser_t parser;
+ibus_snapshot_t latest;
+ibus_stats_t stats;
+uint32_t frame_count = 0;
+// decoded frames on their way to the main loop
+ibus_queue_t frames;
+#if IBUS_TELEMETRY
+// sensors reported to the receiver, the first one gets address 1
+ibus_sensor_t sensors[] = {
+    { IBUS_SENSOR_TEMPERATURE, 2, 400 },
+};
+// estimated arrival time of the byte being parsed
+uint32_t rx_time;
+#endif
+#if IBUS_RX_DMA
+// the DMA ring wrap needs the buffer aligned to its size
+uint8_t rx_ring_data[1 << RX_RING_BITS] __attribute__((aligned(1 << RX_RING_BITS)));
+ibus_ring_t rx_ring;
+int rx_dma_chan;
+// byte count at which the running DMA transfer ends
+uint32_t rx_dma_end = 0xFFFFFFFF;
+repeating_timer_t rx_timer;
+#define RX_ERRORS rx_ring.errors
+#else
+#define RX_ERRORS parser.errors
+#endif
 
-// normalize the value to a range between 0 and 100
-uint16_t normalize(uint16_t value, uint8_t type) {
-    return ((value - 1000) / 10);
+ibus_map_curve_t curves[IBUS_CHANNELS];
+
+// output n drives output_pins[n], failsafe centers servos and stops the ESC
+const uint8_t output_pins[] = { 6, 7, 8, 9 };
+const ibus_output_config_t output_config[] = {
+    { 0, 1500, 500, 1500 },
+    { 1, 1500, 500, 1500 },
+    { 2, 1500, 500, 1500 },
+    { 3, 1500, 500, 1500 },
+};
+ibus_output_t output;
+repeating_timer_t failsafe_timer;
+
+// build the channel curves, sticks get a small deadband around center
+void map_init() {
+    for (uint8_t i = 0; i < IBUS_CHANNELS; i++) {
+        ibus_map_config_t config = IBUS_MAP_DEFAULT;
+        if (i < STICK_CHANNELS) config.deadband = STICK_DEADBAND;
+        ibus_map_configure(&curves[i], &config);
+    }
 }
 
-void on_uart_rx() {
-    // get the first byte of the message
-    uint8_t fb = uart_getc(UART_ID);
-    // get the length of the message and check if valid (between 0x03 and 0x20)
-    if (fb <= PROTOCOL_LENGTH && fb > PROTOCOL_OVERHEAD) {
-        ptr = 0; // reset pointer
-        len = fb - PROTOCOL_OVERHEAD; // set length of message
-        chksum = 0xFFFF - fb; // calculate checksum
-        while(ptr < len) {
-            // get data and update checksum
-            uint8_t value = uart_getc(UART_ID); // get data
-            buffer[ptr++] = value; // store data in buffer
-            chksum -= value; // update checksum
+// handle a frame that passed the checksum
+void on_frame(const uint8_t *frame) {
+    // valid servo command received
+    if (frame[1] == IBUS_COMMAND40) {
+        uint16_t channel[IBUS_CHANNELS];
+        ibus_decode_channels(frame, channel);
+        uint32_t now = time_us_32();
+        // outputs first, everything else can wait a few microseconds
+        int16_t mapped[IBUS_CHANNELS];
+        ibus_map_channels(curves, channel, mapped);
+        ibus_output_frame(&output, mapped, now);
+        ibus_stats_frame(&stats, now);
+        // hand the frame over to the main loop, never waits if it is behind
+        ibus_frame_snapshot_t decoded = { .frame = ++frame_count, .timestamp = now };
+        for (uint8_t i = 0; i < IBUS_CHANNELS; i++) decoded.channel[i] = channel[i];
+        ibus_queue_push(&frames, &decoded);
+        // and to anything that only wants the current sticks
+        ibus_snapshot_publish(&latest, channel, now);
+    }
+#if IBUS_TELEMETRY
+    else {
+        uint8_t reply[IBUS_SENSOR_REPLY_MAX];
+        uint8_t len = ibus_sensor_respond(sensors, sizeof(sensors) / sizeof(sensors[0]), frame,
+                                          time_us_32() - rx_time, reply);
+        if (len) {
+            // the reply comes straight back in on the half-duplex wire
+            ibus_parser_skip(&parser, len);
+            uart_write_blocking(UART_ID, reply, len);
         }
-        lchksum = uart_getc(UART_ID); // get checksum low byte
-        hchksum = uart_getc(UART_ID); // get checksum high byte
-        if(chksum == (hchksum << 8) + lchksum) {
-            // valid servo command received
-            if(buffer[0] == PROTOCOL_COMMAND40) {
-                // extract channel data from buffer
-                for (uint8_t i = 1; i < PROTOCOL_CHANNELS * 2 + 1; i += 2) {
-                    channel[i / 2] = buffer[i] | (buffer[i + 1] << 8);
-                }
+    }
+#endif
+}
+
+// count and clear a receive FIFO overrun
+void check_overrun() {
+    uart_hw_t *hw = uart_get_hw(UART_ID);
+    if (hw->rsr & UART_UARTRSR_OE_BITS) {
+        stats.overruns++;
+        hw->rsr = 0;
+    }
+}
+
+void on_uart_rx() {
+    uint32_t start = time_us_32();
+#if IBUS_TELEMETRY
+    // the newest byte in the FIFO arrived as the level interrupt fired, on
+    // an RX timeout the line has already been idle for 32 bit times. Our
+    // own interrupt latency isn't known and is left out.
+    uint32_t newest = start;
+    if (uart_get_hw(UART_ID)->mis & UART_UARTMIS_RTMIS_BITS) newest -= RX_TIMEOUT_US;
+#endif
+    check_overrun();
+    // drain whatever is in the FIFO and return, the parser keeps its state
+    // between interrupts so a frame can arrive over several of them
+    while (uart_is_readable(UART_ID)) {
+        // empty the FIFO first so every byte's place in it is known
+        uint8_t data[RX_FIFO_DEPTH];
+        uint8_t n = 0;
+        while (n < RX_FIFO_DEPTH && uart_is_readable(UART_ID)) data[n++] = uart_getc(UART_ID);
+        for (uint8_t i = 0; i < n; i++) {
+#if IBUS_TELEMETRY
+            // the bytes before the newest one came in a byte time apart
+            rx_time = newest - (n - 1 - i) * RX_BYTE_US;
+#endif
+            if (ibus_parser_feed(&parser, data[i])) {
+                on_frame(parser.buffer);
             }
         }
+#if IBUS_TELEMETRY
+        // anything still to read came in while these were handled
+        newest = time_us_32();
+#endif
     }
+    ibus_stats_rx_time(&stats, time_us_32() - start);
 }
 
-int main() {
-    // Initialize the standard I/O library
-    stdio_init_all();
-    gpio_init(RED_PIN);
-    gpio_set_dir(RED_PIN, GPIO_OUT);
+#if IBUS_RX_DMA
+// bytes the DMA has written since it started. The write address gives the
+// position in the ring, the transfer count how many laps it went around.
+// The address is read first, the count can only be further along.
+uint32_t rx_dma_written() {
+    uint32_t head = dma_channel_hw_addr(rx_dma_chan)->write_addr - (uintptr_t)rx_ring_data;
+    uint32_t count = rx_dma_end - dma_channel_hw_addr(rx_dma_chan)->transfer_count;
+    return count - ((count - head) & (sizeof(rx_ring_data) - 1));
+}
+
+bool on_rx_poll(repeating_timer_t *rt) {
+    const uint8_t *frame;
+    uint32_t start = time_us_32();
+    check_overrun();
+    uint32_t written = rx_dma_written();
+    uint32_t found = 0;
+    while (ibus_ring_next(&rx_ring, written, &frame)) {
+        on_frame(frame);
+        found++;
+    }
+    // the transfer count runs out after about four days, start it again
+    if (!dma_channel_is_busy(rx_dma_chan)) {
+        dma_channel_set_trans_count(rx_dma_chan, 0xFFFFFFFF, true);
+        rx_dma_end += 0xFFFFFFFF;
+    }
+    // core 1 polls nonstop, only polls that handled a frame are worth timing
+    if (found) ibus_stats_rx_time(&stats, time_us_32() - start);
+    return true;
+}
+
+void rx_dma_init() {
+    ibus_ring_init(&rx_ring, rx_ring_data, sizeof(rx_ring_data));
+    rx_dma_chan = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(rx_dma_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    // wrap the write address around the ring
+    channel_config_set_ring(&c, true, RX_RING_BITS);
+    channel_config_set_dreq(&c, uart_get_dreq(UART_ID, false));
+    dma_channel_configure(rx_dma_chan, &c, rx_ring_data, &uart_get_hw(UART_ID)->dr, 0xFFFFFFFF, true);
+}
+#endif
+
+// the compare registers are double buffered, a new level is picked up at
+// the end of the running period so pulses are never cut short
+void pwm_write(void *ctx, uint8_t index, uint16_t pulse_us) {
+    pwm_set_gpio_level(output_pins[index], pulse_us);
+}
+
+const ibus_output_backend_t pwm_backend = { pwm_write, NULL };
+
+bool on_failsafe_check(repeating_timer_t *rt) {
+    ibus_output_check(&output, time_us_32());
+    return true;
+}
+
+// set up the servo outputs, they stay at failsafe until the first frame
+void output_init() {
+    for (uint8_t i = 0; i < sizeof(output_pins); i++) {
+        gpio_set_function(output_pins[i], GPIO_FUNC_PWM);
+        pwm_config c = pwm_get_default_config();
+        pwm_config_set_clkdiv(&c, (float)clock_get_hz(clk_sys) / SERVO_PWM_HZ);
+        pwm_config_set_wrap(&c, SERVO_PWM_WRAP - 1);
+        pwm_init(pwm_gpio_to_slice_num(output_pins[i]), &c, true);
+    }
+    ibus_output_init(&output, &pwm_backend, output_config, sizeof(output_pins), FAILSAFE_TIMEOUT_US);
+}
+
+// set up the UART and start receiving on the calling core
+void rx_init() {
     // Set up our UART with a basic baud rate.
     uart_init(UART_ID, BAUD_RATE);
     // Set the TX and RX pins by using the function select on the GPIO
@@ -94,27 +295,149 @@ int main() {
     uart_set_format(UART_ID, DATA_BITS, STOP_BITS, PARITY);
     // Turn off FIFO's - we want to do this character by character
     uart_set_fifo_enabled(UART_ID, true);
+#if IBUS_TELEMETRY
+    gpio_set_function(UART_TX_PIN, GPIO_FUNC_UART);
+#endif
+#if IBUS_RX_DMA
+    // Let DMA stream the RX FIFO into the ring buffer
+    rx_dma_init();
+#if !IBUS_CORE1_INGEST
+    // one timer interrupt per poll instead of one per byte, the ring holds
+    // about 22 ms of traffic so there is plenty of slack. The price is up to
+    // RX_POLL_US between a frame arriving and its outputs being written.
+    add_repeating_timer_us(-RX_POLL_US, on_rx_poll, NULL, &rx_timer);
+#endif
+#else
     // Select correct interrupt for the UART we are using
     int UART_IRQ = UART_ID == uart0 ? UART0_IRQ : UART1_IRQ;
-    // And set up and enable the interrupt handlers
+    // And set up and enable the interrupt handlers, on the calling core
     irq_set_exclusive_handler(UART_IRQ, on_uart_rx);
     irq_set_enabled(UART_IRQ, true);
-    // Now enable the UART to send interrupts - RX only
+    // Now enable the UART to send interrupts - RX only. This also sets the
+    // RX level to 1/8 full, so a 4 byte sensor poll that starts on an empty
+    // FIFO is answered without waiting for the RX timeout.
     uart_set_irq_enables(UART_ID, true, false);
-    // The main loop
+#endif
+}
+
+#if IBUS_CORE1_INGEST
+void core1_entry() {
+    output_init();
+    rx_init();
+#if IBUS_RX_DMA
+    while (true) {
+        // nothing else runs here, keep polling the ring
+        on_rx_poll(NULL);
+        ibus_output_check(&output, time_us_32());
+    }
+#else
+    // the failsafe check must not preempt the UART interrupt, so its timer
+    // interrupt has to fire on this core as well
+    alarm_pool_t *pool = alarm_pool_create(FAILSAFE_ALARM, 1);
+    alarm_pool_add_repeating_timer_us(pool, -FAILSAFE_CHECK_US, on_failsafe_check, NULL, &failsafe_timer);
     while (true) {
-        gpio_put(RED_PIN, 1);
-        sleep_ms(250);
-        gpio_put(RED_PIN, 0);
-        sleep_ms(250);
-        printf(
-            "Channel 1: %d Channel 2: %d Channel 3: %d Channel 4: %d Channel 5: %d Channel 6: %d \n",
-            normalize(channel[0], 0),
-            normalize(channel[1], 0),
-            normalize(channel[2], 0),
-            normalize(channel[3], 0),
-            normalize(channel[4], 1),
-            normalize(channel[5], 1)
-        );
+        // the interrupts do the work
+        __wfi();
+    }
+#endif
+}
+#endif
+
+#if IBUS_TELEMETRY
+// refresh the sensor table, the die temperature stands in for a real sensor
+void update_sensors() {
+    float volts = adc_read() * 3.3f / (1 << 12);
+    float celsius = 27.0f - (volts - 0.706f) / 0.001721f;
+    sensors[0].value = (int32_t)(celsius * 10) + 400;
+}
+#endif
+
+// records are built in place here, nothing is formatted through stdio
+uint8_t stream_buffer[IBUS_STREAM_MAX];
+uint32_t stream_dropped = 0;
+uint32_t stream_backoff_us = 0;
+uint32_t stream_retry_us;
+
+// send the record in stream_buffer over USB CDC. If the host isn't reading
+// the record is dropped and the next attempt waits, twice as long after
+// every failure, so a full FIFO doesn't cost anything. Only the main loop
+// touches TinyUSB, it isn't reentrant.
+bool stream_send(uint8_t len) {
+    uint32_t now = time_us_32();
+    if (stream_backoff_us && (int32_t)(now - stream_retry_us) < 0) {
+        stream_dropped++;
+        return false;
+    }
+    if (!tud_cdc_connected() || tud_cdc_write_available() < len) {
+        stream_dropped++;
+        stream_backoff_us = stream_backoff_us ? stream_backoff_us * 2 : STREAM_BACKOFF_MIN_US;
+        if (stream_backoff_us > STREAM_BACKOFF_MAX_US) stream_backoff_us = STREAM_BACKOFF_MAX_US;
+        stream_retry_us = now + stream_backoff_us;
+        return false;
+    }
+    stream_backoff_us = 0;
+    tud_cdc_write(stream_buffer, len);
+    tud_cdc_write_flush();
+    return true;
+}
+
+void send_stats(ibus_stats_report_t *report) {
+    ibus_stats_record_t *record = (ibus_stats_record_t *)(stream_buffer + IBUS_STREAM_HEADER);
+    ibus_stats_losses_t losses = {
+        .queue_drops = atomic_load_explicit(&frames.dropped, memory_order_relaxed),
+        .failsafes = output.failsafes,
+        .stream_drops = stream_dropped,
+    };
+    ibus_stats_record(report, &stats, &RX_ERRORS, &losses, time_us_32(), record);
+    stream_send(ibus_stream_seal(stream_buffer, IBUS_STREAM_STATS, sizeof(*record)));
+}
+
+int main() {
+    tusb_init();
+    ibus_parser_init(&parser);
+    ibus_snapshot_init(&latest);
+    ibus_stats_init(&stats);
+    map_init();
+    gpio_init(RED_PIN);
+    gpio_set_dir(RED_PIN, GPIO_OUT);
+#if IBUS_TELEMETRY
+    adc_init();
+    adc_set_temp_sensor_enabled(true);
+    adc_select_input(TEMP_ADC_INPUT);
+#endif
+    ibus_queue_init(&frames);
+#if IBUS_CORE1_INGEST
+    multicore_launch_core1(core1_entry);
+#else
+    output_init();
+    rx_init();
+    add_repeating_timer_us(-FAILSAFE_CHECK_US, on_failsafe_check, NULL, &failsafe_timer);
+#endif
+    // The main loop, never blocks so every frame makes it into the stream
+    ibus_frame_snapshot_t frame;
+    ibus_stats_report_t report;
+    uint32_t led_time = time_us_32();
+    uint32_t stats_time = led_time;
+    bool led = false;
+    ibus_stats_report_init(&report, stats_time);
+    while (true) {
+        tud_task();
+        while (ibus_queue_pop(&frames, &frame)) {
+            stream_send(ibus_stream_frame(stream_buffer, &frame));
+        }
+        uint32_t now = time_us_32();
+        if (now - led_time >= LED_PERIOD_US) {
+            led_time = now;
+            led = !led;
+            gpio_put(RED_PIN, led);
+        }
+        if (now - stats_time >= STATS_PERIOD_US) {
+            stats_time = now;
+#if IBUS_TELEMETRY
+            update_sensors();
+#endif
+            send_stats(&report);
+        }
+        tight_loop_contents();
     }
 }
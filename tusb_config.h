@@ -0,0 +1,22 @@
+#ifndef TUSB_CONFIG_H
+#define TUSB_CONFIG_H
+
+/*
+  TinyUSB configuration. stdio_usb is off, the main loop owns the USB stack
+  and is the only caller of tud_task() and the CDC functions.
+ */
+
+#define CFG_TUSB_RHPORT0_MODE OPT_MODE_DEVICE
+#ifndef CFG_TUSB_OS
+#define CFG_TUSB_OS OPT_OS_PICO
+#endif
+
+#define CFG_TUD_ENDPOINT0_SIZE 64
+
+// a single CDC interface carrying the record stream
+#define CFG_TUD_CDC 1
+#define CFG_TUD_CDC_RX_BUFSIZE 64
+#define CFG_TUD_CDC_TX_BUFSIZE 256
+#define CFG_TUD_CDC_EP_BUFSIZE 64
+
+#endif
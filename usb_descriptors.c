@@ -0,0 +1,94 @@
+#include <string.h>
+#include "pico/unique_id.h"
+#include "tusb.h"
+
+/*
+  USB descriptors for the record stream, one CDC ACM interface. The IDs are
+  the ones the SDK's stdio_usb uses so host tools find the board the same
+  way as before.
+ */
+
+#define USB_VID 0x2E8A
+#define USB_PID 0x000A
+#define USB_BCD 0x0200
+
+#define ITF_NUM_CDC 0
+#define ITF_NUM_CDC_DATA 1
+#define ITF_NUM_TOTAL 2
+
+#define EPNUM_CDC_NOTIF 0x81
+#define EPNUM_CDC_OUT 0x02
+#define EPNUM_CDC_IN 0x82
+
+#define STRID_LANGID 0
+#define STRID_MANUFACTURER 1
+#define STRID_PRODUCT 2
+#define STRID_SERIAL 3
+#define STRID_CDC 4
+
+#define USB_CONFIG_LEN (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN)
+
+static const tusb_desc_device_t usb_device = {
+    .bLength = sizeof(tusb_desc_device_t),
+    .bDescriptorType = TUSB_DESC_DEVICE,
+    .bcdUSB = USB_BCD,
+    // interface association, the CDC interfaces come as a pair
+    .bDeviceClass = TUSB_CLASS_MISC,
+    .bDeviceSubClass = MISC_SUBCLASS_COMMON,
+    .bDeviceProtocol = MISC_PROTOCOL_IAD,
+    .bMaxPacketSize0 = CFG_TUD_ENDPOINT0_SIZE,
+    .idVendor = USB_VID,
+    .idProduct = USB_PID,
+    .bcdDevice = 0x0100,
+    .iManufacturer = STRID_MANUFACTURER,
+    .iProduct = STRID_PRODUCT,
+    .iSerialNumber = STRID_SERIAL,
+    .bNumConfigurations = 1,
+};
+
+static const uint8_t usb_config[USB_CONFIG_LEN] = {
+    TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, USB_CONFIG_LEN, 0, 100),
+    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC, STRID_CDC, EPNUM_CDC_NOTIF, 8, EPNUM_CDC_OUT, EPNUM_CDC_IN, 64),
+};
+
+static const char *const usb_strings[] = {
+    [STRID_MANUFACTURER] = "Raspberry Pi",
+    [STRID_PRODUCT] = "rccar iBUS",
+    [STRID_CDC] = "iBUS records",
+};
+
+const uint8_t *tud_descriptor_device_cb(void) {
+    return (const uint8_t *)&usb_device;
+}
+
+const uint8_t *tud_descriptor_configuration_cb(uint8_t index) {
+    (void)index;
+    return usb_config;
+}
+
+// string descriptors are built on request, UTF-16 with a two byte header
+const uint16_t *tud_descriptor_string_cb(uint8_t index, uint16_t langid) {
+    static uint16_t desc[1 + 32];
+    static char serial[2 * PICO_UNIQUE_BOARD_ID_SIZE_BYTES + 1];
+    (void)langid;
+    uint8_t len;
+    if (index == STRID_LANGID) {
+        desc[1] = 0x0409; // English
+        len = 1;
+    } else {
+        const char *str;
+        if (index == STRID_SERIAL) {
+            pico_get_unique_board_id_string(serial, sizeof(serial));
+            str = serial;
+        } else if (index < sizeof(usb_strings) / sizeof(usb_strings[0]) && usb_strings[index]) {
+            str = usb_strings[index];
+        } else {
+            return NULL;
+        }
+        len = strlen(str);
+        if (len > 32) len = 32;
+        for (uint8_t i = 0; i < len; i++) desc[1 + i] = str[i];
+    }
+    desc[0] = (TUSB_DESC_STRING << 8) | (2 * len + 2);
+    return desc;
+}